@@ -0,0 +1,123 @@
+/* Strong-scaling benchmark for Sort_quicksort_parallel_array().
+
+   Sorts the same array of random items on 1, 2, 4, ... threads, up to the
+   number of online CPUs (or max_threads), and prints, for each thread count,
+   the best wall-clock time out of a few runs, the speedup over 1 thread,
+   and the parallel efficiency (speedup / threads).
+
+   1 thread is the sequential sort that Sort_quicksort_parallel_array() falls
+   back to, Sort_pdqsort_array(), so the speedups are over the best
+   sequential quicksort, not over the parallel one on 1 thread.
+
+   Build, from this directory, along with the rest of the library that
+   sorting.c depends on (the linked list and binary search tree modules):
+
+        cc -std=c11 -O2 -I.. quicksort_scaling.c ../sorting.c ../heapsort.c \
+           ../work_pool.c <list and tree sources> -o quicksort_scaling -lpthread
+
+   Usage:
+        ./quicksort_scaling [items] [max_threads] [runs]
+
+   items defaults to 2^27, max_threads to the number of online CPUs, runs to 3.
+   For a clean curve, run it on an otherwise idle machine, and with items
+   well above the sequential cutoff (PARALLEL_QUICKSORT_CUTOFF in sorting.c).
+*/
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "sorting.h"
+
+
+static double Seconds_now(void){
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double)now.tv_sec + (double)now.tv_nsec * 1e-9;
+}
+
+
+
+static int Is_sorted(const char the_array[], size_t length){
+    for (size_t i = 1; i < length; i++){
+        if (the_array[i] < the_array[i-1]){
+            return 0;
+        }
+    }
+    return 1;
+}
+
+
+
+static double Best_time(const char source[], char work[], size_t length, unsigned int threads, int runs){
+    /* Best wall-clock time of runs sorts of a fresh copy of source, or a
+       negative time if a sort's output came out unsorted */
+    double best = -1.0;
+
+    for (int run = 0; run < runs; run++){
+        memcpy(work, source, length);
+        double start = Seconds_now();
+        Sort_quicksort_parallel_array(work, length, threads);
+        double elapsed = Seconds_now() - start;
+
+        if (!Is_sorted(work, length)){
+            return -1.0;
+        }
+        if (best < 0 || elapsed < best){
+            best = elapsed;
+        }
+    }
+    return best;
+}
+
+
+
+int main(int argc, char *argv[]){
+    size_t length = (argc > 1) ? strtoull(argv[1], NULL, 10) : ((size_t)1 << 27);
+    long online = sysconf(_SC_NPROCESSORS_ONLN);
+    unsigned int max_threads = (argc > 2) ? (unsigned int)strtoul(argv[2], NULL, 10)
+                                          : (online > 0 ? (unsigned int)online : 1);
+    int runs = (argc > 3) ? atoi(argv[3]) : 3;
+
+    if (length == 0 || max_threads == 0 || runs <= 0){
+        fprintf(stderr, "usage: %s [items] [max_threads] [runs]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    char *source = malloc(length);
+    char *work = malloc(length);
+    if (!source || !work){
+        fprintf(stderr, "can't allocate 2 x %zu bytes\n", length);
+        return EXIT_FAILURE;
+    }
+    srand(12345);
+    for (size_t i = 0; i < length; i++){
+        source[i] = (char)rand();
+    }
+
+    printf("%zu items, best of %d runs, %ld online CPUs\n", length, runs, online);
+    printf("%8s %12s %9s %11s\n", "threads", "time (ms)", "speedup", "efficiency");
+
+    double sequential = 0.0;
+    for (unsigned int threads = 1; ; threads = (threads*2 < max_threads) ? threads*2 : max_threads){
+        double elapsed = Best_time(source, work, length, threads, runs);
+        if (elapsed < 0){
+            fprintf(stderr, "output not sorted on %u threads\n", threads);
+            return EXIT_FAILURE;
+        }
+        if (threads == 1){
+            sequential = elapsed;
+        }
+        double speedup = sequential / elapsed;
+        printf("%8u %12.1f %9.2f %10.0f%%\n", threads, elapsed * 1e3, speedup, 100.0 * speedup / threads);
+
+        if (threads == max_threads){
+            break;
+        }
+    }
+
+    free(source);
+    free(work);
+    return EXIT_SUCCESS;
+}
@@ -1,5 +1,5 @@
 #include "heapsort.h"
-#include <stdlib.h>
+#include "sort_common.h"
 
 
 /* ************************************************ */
@@ -30,8 +30,10 @@
     be sorted, the sorting is done in place and the space
     complexity is constant. No further space is required
     aside from that required by the functions operating
-    on the heap and the memory allocated for a temporary
-    Heap struct, which the functions do internally. 
+    on the heap, and a Heap struct, which Heap_sort()
+    keeps on its stack: nothing is ever allocated, so
+    Heap_sort() can't fail, and costs nothing more than
+    the sort itself, however small the array.
 
                 * * *
 
@@ -64,11 +66,11 @@
     a max heap, where the parent is always greater than both
     of its children.
 
-    The max-heapify function returns a Heap 'object' (a struct ptr)
+    The max-heapify function fills in a Heap 'object' (a struct ptr)
     which serves as a way to pass multiple parameters (its internal
     values) to the Heap_popS (heap pop, sort) function. That is,
-    the only use for the returned value is to be passed as an 
-    argumetn to Heap_popS().
+    the only use for the filled in struct is to be passed as an 
+    argument to Heap_popS().
 
     b) The latter is accomplished by a call to the aforementioned
     Heap_popS().
@@ -98,9 +100,8 @@
     former heap rootsto the right of it, in ascending order. 
     The sorting is done. 
     
-    Heap_popS() will internally deallocate the memory allocated
-    by Heap_max_heapify() for Heap, so nothing else needs to be
-    done.
+    The Heap struct lives on Heap_sort()'s stack, so nothing
+    else needs to be done.
 
 *  -------------------------------------------------------------- */
 /* ************************************************************** */
@@ -116,6 +117,15 @@ struct max_heap_implicit_fs{
 typedef struct max_heap_implicit_fs *Heap;
 
 
+// An empty statement the compiler can't remove or move around: put in one arm
+// of an if, it keeps the if from being compiled to a conditional move.
+#if defined(__GNUC__)
+#define HEAP_KEEP_BRANCH() __asm__ volatile("")
+#else
+#define HEAP_KEEP_BRANCH() ((void)0)
+#endif
+
+
 
 
 
@@ -124,39 +134,20 @@ typedef struct max_heap_implicit_fs *Heap;
 /* ********************************************************************************* */
 /* ---------------------------- PRIVATE FUNCTIONS ---------------------------------- */
 
-static void Heap_init(Heap *heap_ref, char the_array[], int32_t size_of_the_array){
+static void Heap_init(Heap heap, char the_array[], int32_t size_of_the_array){
     /* size_of_the_array has to be number of items in the_array, excluding Nul
-       
-       allocate memory for a min_heap_implicit struct
-    */
-    Heap new_max_heap = malloc(sizeof(struct max_heap_implicit_fs));
-    new_max_heap->array = the_array;
 
-    if (!new_max_heap){
-        exit(EXIT_FAILURE);
-    }
-     
-    new_max_heap->last_index = -1;
-    new_max_heap->size = size_of_the_array;     
-
-    *heap_ref = new_max_heap;
-}
-
-   
- 
-static void Heap_destroy(Heap *heap_ref){
-    /* Free all memory associated with the heap
-       and set *heap_ref to NULL.
+       initialize the max_heap_implicit_fs struct heap points to; it's
+       provided by the caller, typically on its stack, so nothing is
+       allocated and this can't fail
     */
-    if (!(*heap_ref)){
-        return;
-    }
-
-    free(*heap_ref);
-    *heap_ref = NULL;
+    heap->array = the_array;
+    heap->last_index = -1;
+    heap->size = size_of_the_array;
 }
 
 
+
 static void Heap_sift_up(char the_array[], int32_t current_index){
     /* Sift the value at current index up in the array */
     char temp;
@@ -180,19 +171,22 @@ static void Heap_sift_up(char the_array[], int32_t current_index){
 
 
 
-static void Heap_sift_down(char the_array[], int32_t current_index, int32_t last_index){
+static void Heap_sift_down(char the_array[], size_t current_index, size_t last_index){
     /* Sift down the root to its correct position in the_array so
        as to repair and uphold the heap property (children > parent).
+
+       Indices are size_t so that Heap_sort_n() can use this on arrays
+       of any length.
     */
-    int32_t current = current_index;
-    int32_t left_child = 1 + (current<<1);
-    int32_t right_child = 2 + (current<<1);
+    size_t current = current_index;
+    size_t left_child = 1 + (current<<1);
+    size_t right_child = 2 + (current<<1);
    
     char temp;
     
     while(left_child <= last_index){
         // has left child at least
-        int32_t child = left_child;
+        size_t child = left_child;
 
         // check if it also has a right child. If it does, get the larger of the two
         if (right_child <= last_index){
@@ -215,18 +209,16 @@ static void Heap_sift_down(char the_array[], int32_t current_index, int32_t last
 }
 
 // top-down heap construction
-Heap static Heap_max_heapify_td(char the_array[], int32_t size){
+static void Heap_max_heapify_td(Heap max_heap, char the_array[], int32_t size){
     /* Start at the beginning of the array, and grow  the heap
        by inserting into it the next index.
        Heap_sift_up() is called on the heap then to reestablish 
        the heap property.
 
-       The return value is a Heap : initialized properly and everything, to be
+       max_heap is initialized properly and everything, to be
        passed to Heap_pops().
     */
-    
-    Heap max_heap;
-    Heap_init(&max_heap, the_array, size);
+    Heap_init(max_heap, the_array, size);
     
     int32_t last_index = size-1; 
     // start at 1: consider the root already inserted
@@ -236,17 +228,12 @@ Heap static Heap_max_heapify_td(char the_array[], int32_t size){
     // the array is maxheapified. The max heap has been built.
     // update the max_heap Heap
     max_heap->last_index = last_index;
-    max_heap->size = size;
-    max_heap->array = the_array;
-
-    return max_heap;
 };
     
 
 //bottom-up heap construction -- more efficient than the top-top approach
-Heap static Heap_max_heapify_bu(char the_array[], int32_t size){
-    Heap max_heap;
-    Heap_init(&max_heap, the_array, size);
+static void Heap_max_heapify_bu(Heap max_heap, char the_array[], int32_t size){
+    Heap_init(max_heap, the_array, size);
     
     int32_t last_index = size-1; 
     int32_t first_non_leaf = (last_index-1)>>1;
@@ -257,24 +244,13 @@ Heap static Heap_max_heapify_bu(char the_array[], int32_t size){
     // the array is maxheapified. The max heap has been built.
     // update the max_heap Heap
     max_heap->last_index = last_index;
-    max_heap->size = size;
-    max_heap->array = the_array;
-
-    return max_heap;
-
-
-
 }
 
-static void Heap_popS(Heap *heap_ref){
+static void Heap_popS(Heap max_heap){
     /* Repeatedly remove the root of the heap
        (the max value) and put it at the end of the heap,
        then shrink the heap section by one.
-
-       Deallocate the space for the heap and set its pointer
-       to NULL when finished, by calling Heap_destroy().
     */
-    Heap max_heap = *heap_ref;
     int32_t last_index = max_heap->last_index;
     char *the_array = max_heap->array;
     
@@ -301,7 +277,190 @@ static void Heap_popS(Heap *heap_ref){
          // }
      // }
 
-    Heap_destroy(heap_ref); 
+    max_heap->last_index = last_index;
+}
+
+
+
+
+static void Heap_sift_down_generic(char *base, size_t current_index, size_t last_index,
+                                   size_t size, Sort_compare_fn compare){
+    /* Element-size-agnostic version of Heap_sift_down(): the heap stores
+       elements of size bytes each, ordered by compare.
+    */
+    size_t current = current_index;
+    size_t left_child = 1 + (current<<1);
+    size_t right_child = 2 + (current<<1);
+
+    while(left_child <= last_index){
+        size_t child = left_child;
+
+        if (right_child <= last_index){
+            child = (compare(base + left_child*size, base + right_child*size) > 0) ? left_child : right_child;
+        }
+        if (compare(base + child*size, base + current*size) > 0){
+            Sort_swap_elements(base + child*size, base + current*size, size);
+
+            current = child;
+            left_child = 1 + (current<<1);
+            right_child = 2 + (current<<1);
+        }
+        else{
+            break;
+        }
+    }
+}
+
+
+static void Heap_sift_down_bottom_up(char the_array[], size_t current_index, size_t last_index){
+    /* Same result as Heap_sift_down(), with about half the comparisons.
+
+       Heap_sift_down() compares the two children with each other, and then
+       the larger one with the value being sifted, at every level. But the
+       value sifted down from the root during the sort was just taken from the
+       bottom of the heap, and nearly always belongs back near the bottom.
+       So instead:
+        1. walk down the path of larger children all the way to a leaf,
+           with one comparison per level;
+        2. walk back up that path from the leaf to the first node not smaller
+           than the value sifted -- usually only a level or two;
+        3. put the value there, shifting the nodes of the path above it
+           up one level each.
+    */
+    size_t leaf = current_index;
+    size_t child;
+
+    while ((child = 2 + (leaf<<1)) <= last_index){
+        leaf = (the_array[child-1] > the_array[child]) ? child-1 : child;
+    }
+    if (child-1 == last_index){
+        leaf = child-1;     // a lone left child
+    }
+
+    char value = the_array[current_index];
+    while (leaf > current_index && the_array[leaf] < value){
+        leaf = (leaf-1)>>1;
+    }
+
+    // the value goes to leaf, and the nodes on the path above it move up
+    char displaced = the_array[leaf];
+    the_array[leaf] = value;
+    while (leaf > current_index){
+        leaf = (leaf-1)>>1;
+        char temp = the_array[leaf];
+        the_array[leaf] = displaced;
+        displaced = temp;
+    }
+}
+
+
+
+static void Heap_sift_down_bottom_up_generic(char *base, size_t current_index, size_t last_index,
+                                             size_t size, Sort_compare_fn compare){
+    /* Element-size-agnostic version of Heap_sift_down_bottom_up().
+
+       Step 3 is a sequence of swaps of the current_index node with the nodes
+       of the path, from the bottom up: the first puts the value sifted in
+       place, and each of the next ones moves a node up to its parent's place.
+
+       The choice of child in step 1 is kept a branch rather than a
+       conditional move: the branch is mispredicted half the time, but a
+       predicted branch lets the CPU go on to load the next level's elements
+       while the comparator runs, whereas a conditional move makes it wait
+       for the result. With comparators that chase pointers, such as strcmp()
+       on an array of strings, that's most of the cost.
+    */
+    size_t leaf = current_index;
+    size_t child;
+
+    while ((child = 2 + (leaf<<1)) <= last_index){
+        if (compare(base + (child-1)*size, base + child*size) > 0){
+            HEAP_KEEP_BRANCH();
+            child--;
+        }
+        leaf = child;
+    }
+    if (child-1 == last_index){
+        leaf = child-1;
+    }
+
+    char *value = base + current_index*size;
+    while (leaf > current_index && compare(base + leaf*size, value) < 0){
+        leaf = (leaf-1)>>1;
+    }
+
+    while (leaf > current_index){
+        Sort_swap_elements(value, base + leaf*size, size);
+        leaf = (leaf-1)>>1;
+    }
+}
+
+
+
+static inline void Heap_sift_down_dary(char the_array[], size_t current_index, size_t last_index,
+                                       unsigned int log_arity){
+    /* Same as Heap_sift_down(), on a heap where every node has 2^log_arity
+       children: the children of the node at i are at (i << log_arity) + 1
+       and the next ones.
+       Rather than being swapped down level by level, the value sifted is kept
+       aside, and the larger children moved up into the hole it leaves, then
+       the value is written once where the hole ends up.
+    */
+    size_t current = current_index;
+    char value = the_array[current];
+
+    if (last_index == 0){
+        return;
+    }
+    size_t last_parent = (last_index-1) >> log_arity;
+
+    while (current <= last_parent){
+        size_t first_child = (current << log_arity) + 1;
+        size_t last_child = first_child + ((size_t)1 << log_arity) - 1;
+        size_t largest = first_child;
+        char largest_value = the_array[first_child];
+
+        if (last_child > last_index){
+            last_child = last_index;
+        }
+        // which child is the largest is unpredictable: keep this branch-free
+        for (size_t child = first_child+1; child <= last_child; child++){
+            char child_value = the_array[child];
+            largest = (child_value > largest_value) ? child : largest;
+            largest_value = (child_value > largest_value) ? child_value : largest_value;
+        }
+        if (largest_value <= value){
+            break;
+        }
+        the_array[current] = largest_value;
+        current = largest;
+    }
+    the_array[current] = value;
+}
+
+
+
+static inline void Heap_sort_dary_P(char the_array[], size_t size, unsigned int log_arity){
+    /* Heap_sort_n() on a heap of arity 2^log_arity. Always called with a
+       constant log_arity, so that each arity gets its own copy, with the
+       loop over the children unrolled. */
+    if (size < 2){
+        return;
+    }
+
+    size_t last_index = size-1;
+    for (size_t non_leaf = ((last_index-1) >> log_arity) + 1; non_leaf-- > 0;){
+        Heap_sift_down_dary(the_array, non_leaf, last_index, log_arity);
+    }
+
+    char temp;
+    while (last_index){
+        temp = the_array[0];
+        the_array[0] = the_array[last_index];
+        the_array[last_index] = temp;
+        last_index--;
+        Heap_sift_down_dary(the_array, 0, last_index, log_arity);
+    }
 }
 
 
@@ -315,9 +474,146 @@ void Heap_sort(char the_array[], int32_t size){
     /* Wrapper function that calls Heap_max_heapify()
        to turn the_array into a max_heap, then
        completes the sorting by calling Heap_popS().
+
+       The Heap struct is a local variable: no memory is allocated, which
+       matters when sorting many small arrays.
     */
-    Heap max_heap = Heap_max_heapify_bu(the_array, size);
+    struct max_heap_implicit_fs max_heap;
+
+    if (size < 2){
+        return;
+    }
+    Heap_max_heapify_bu(&max_heap, the_array, size);
     Heap_popS(&max_heap);
 }
 
 
+
+void Heap_sort_n(char the_array[], size_t size){
+    /* Same as Heap_sort(), for arrays of any length: size is a size_t and
+       the heap is tracked in local variables rather than in a Heap struct,
+       whose indices are int32_t. Nothing is allocated.
+    */
+    if (size < 2){
+        return;
+    }
+
+    size_t last_index = size-1;
+    for (size_t non_leaf = size>>1; non_leaf-- > 0;){
+        Heap_sift_down(the_array, non_leaf, last_index);
+    }
+
+    char temp;
+    while (last_index){
+        temp = the_array[0];
+        the_array[0] = the_array[last_index];
+        the_array[last_index] = temp;
+        last_index--;
+        Heap_sift_down(the_array, 0, last_index);
+    }
+}
+
+
+void Heap_sort_generic(void *base, size_t count, size_t size, Sort_compare_fn compare){
+    /* Type-generic version of Heap_sort(): sort count elements of size bytes
+       each, ordered by compare.
+
+       Same two phases as Heap_sort(): bottom-up heap construction as in
+       Heap_max_heapify_bu(), followed by the root-popping loop of Heap_popS().
+       The heap bookkeeping fits in local variables, so no Heap struct is allocated.
+    */
+    char *the_array = base;
+
+    if (count < 2){
+        return;
+    }
+
+    size_t last_index = count-1;
+    for (size_t non_leaf = (last_index+1)>>1; non_leaf-- > 0;){
+        Heap_sift_down_generic(the_array, non_leaf, last_index, size, compare);
+    }
+
+    while (last_index){
+        Sort_swap_elements(the_array, the_array + last_index*size, size);
+        last_index--;
+        Heap_sift_down_generic(the_array, 0, last_index, size, compare);
+    }
+}
+
+
+
+void Heap_sort_dary(char the_array[], size_t size, unsigned int arity){
+    /* Same as Heap_sort_n(), with a heap whose nodes have arity children
+       rather than 2.
+
+       A d-ary heap of n nodes is only log_d(n) levels deep, so a sift
+       down takes fewer steps, each of which compares d children instead of 2.
+       That's more comparisons in total, but the d children of a node sit next
+       to each other in the array, so they take one cache line (or two) to
+       read, where a binary heap touches a new line at nearly every level once
+       it's larger than the cache. The wider heap pays off on large arrays.
+    */
+    switch (arity){
+        case 4:
+            Heap_sort_dary_P(the_array, size, 2);
+            break;
+        case 8:
+            Heap_sort_dary_P(the_array, size, 3);
+            break;
+        default:
+            Heap_sort_dary_P(the_array, size, 1);
+            break;
+    }
+}
+
+
+
+void Heap_sort_bottom_up(char the_array[], size_t size){
+    /* Same as Heap_sort_n(), with the bottom-up sift down of
+       Heap_sift_down_bottom_up(), in both the heap construction and the
+       root-popping loop: about n log2(n) comparisons in all, rather than
+       about 2n log2(n).
+    */
+    if (size < 2){
+        return;
+    }
+
+    size_t last_index = size-1;
+    for (size_t non_leaf = size>>1; non_leaf-- > 0;){
+        Heap_sift_down_bottom_up(the_array, non_leaf, last_index);
+    }
+
+    char temp;
+    while (last_index){
+        temp = the_array[0];
+        the_array[0] = the_array[last_index];
+        the_array[last_index] = temp;
+        last_index--;
+        Heap_sift_down_bottom_up(the_array, 0, last_index);
+    }
+}
+
+
+void Heap_sort_bottom_up_generic(void *base, size_t count, size_t size, Sort_compare_fn compare){
+    /* Same as Heap_sort_generic(), with the bottom-up sift down of
+       Heap_sift_down_bottom_up_generic(). It's the one to use when comparisons
+       are expensive -- e.g. strings, or keys looked up through a pointer -- since
+       it makes about half as many.
+    */
+    char *the_array = base;
+
+    if (count < 2){
+        return;
+    }
+
+    size_t last_index = count-1;
+    for (size_t non_leaf = count>>1; non_leaf-- > 0;){
+        Heap_sift_down_bottom_up_generic(the_array, non_leaf, last_index, size, compare);
+    }
+
+    while (last_index){
+        Sort_swap_elements(the_array, the_array + last_index*size, size);
+        last_index--;
+        Heap_sift_down_bottom_up_generic(the_array, 0, last_index, size, compare);
+    }
+}
@@ -1,6 +1,20 @@
 #include <stdint.h>
+#include "sort_common.h"
 
 // size is the number of elements the_array can hold, not counting Nul
 void Heap_sort(char the_array[], int32_t size);
 
+// same as Heap_sort(), for arrays longer than INT32_MAX; allocates nothing
+void Heap_sort_n(char the_array[], size_t size);
 
+// same as Heap_sort_n(), on a heap where every node has arity children;
+// arity is 2, 4 or 8 -- anything else is taken as 2
+void Heap_sort_dary(char the_array[], size_t size, unsigned int arity);
+
+// sort count elements of size bytes each, starting at base, ordered by compare
+void Heap_sort_generic(void *base, size_t count, size_t size, Sort_compare_fn compare);
+
+// bottom-up heapsort: same results as Heap_sort_n() and Heap_sort_generic(),
+// with about half as many comparisons
+void Heap_sort_bottom_up(char the_array[], size_t size);
+void Heap_sort_bottom_up_generic(void *base, size_t count, size_t size, Sort_compare_fn compare);
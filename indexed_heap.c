@@ -0,0 +1,256 @@
+#include "indexed_heap.h"
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+/* ************************************************ */
+/* --------------- IMPLEMENTATION NOTES ------------*/
+/*                      * * *
+    The heap is an implicit binary max heap, laid out as in heapsort.c and
+    priority_queue.c, of ids rather than of the keys themselves. Keys are
+    kept in a separate array, indexed by id, so a sift only moves ids around,
+    whatever the size of the keys, and the key of an id never moves -- which is
+    what lets Iheap_key() hand out a pointer to it.
+
+    position[id] is the slot of id in the heap, or NOT_IN_HEAP. Every time an
+    id is moved to another slot, its position is updated, so it's always
+    known where to start sifting from when its key changes, or when it's
+    removed.
+
+    As in priority_queue.c, the sifts move the ids they pass over into the
+    hole left by the one being sifted, rather than swapping them, and only
+    write the sifted id to its slot at the end.
+
+    Removing the item at slot s moves the last one of the heap into s. That
+    item came from the bottom of the heap, so it's normally sifted down, but
+    it may be greater than the parent of s, if s was in another subtree, so
+    it's sifted up first.
+*  -------------------------------------------------------------- */
+/* ************************************************************** */
+
+
+// position of an id that isn't in the heap
+#define NOT_IN_HEAP SIZE_MAX
+
+
+struct indexed_heap{
+    size_t *heap;               // ids, in heap order
+    size_t *position;           // per id: its slot in heap, or NOT_IN_HEAP
+    char *keys;                 // per id: its key, if it's in the heap
+    size_t count;
+    size_t ids;
+    size_t key_size;
+    Sort_compare_fn compare;
+};
+
+
+
+
+
+
+
+/* ********************************************************************************* */
+/* ---------------------------- PRIVATE FUNCTIONS ---------------------------------- */
+
+static inline const char *Iheap_key_of(Iheap heap, size_t id){
+    return heap->keys + id*heap->key_size;
+}
+
+
+
+static size_t Iheap_sift_up(Iheap heap, size_t slot, size_t id){
+    /* Sift id up from the empty slot, and return the slot it ends up in */
+    const char *key = Iheap_key_of(heap, id);
+
+    while (slot > 0){
+        size_t parent = (slot-1)>>1;
+        size_t parent_id = heap->heap[parent];
+
+        if (heap->compare(Iheap_key_of(heap, parent_id), key) >= 0){
+            break;
+        }
+        heap->heap[slot] = parent_id;
+        heap->position[parent_id] = slot;
+        slot = parent;
+    }
+    heap->heap[slot] = id;
+    heap->position[id] = slot;
+    return slot;
+}
+
+
+
+static void Iheap_sift_down(Iheap heap, size_t slot, size_t id){
+    /* Sift id down from the empty slot */
+    const char *key = Iheap_key_of(heap, id);
+    size_t child;
+
+    while ((child = 1 + (slot<<1)) < heap->count){
+        // the larger of the children
+        if (child+1 < heap->count &&
+            heap->compare(Iheap_key_of(heap, heap->heap[child+1]), Iheap_key_of(heap, heap->heap[child])) > 0){
+            child++;
+        }
+        size_t child_id = heap->heap[child];
+
+        if (heap->compare(Iheap_key_of(heap, child_id), key) <= 0){
+            break;
+        }
+        heap->heap[slot] = child_id;
+        heap->position[child_id] = slot;
+        slot = child;
+    }
+    heap->heap[slot] = id;
+    heap->position[id] = slot;
+}
+
+/* ------------------------------- END PRIVATE ------------------------------------- */
+/* ********************************************************************************* */
+
+
+
+
+Iheap Iheap_create(size_t ids, size_t key_size, Sort_compare_fn compare){
+    if (key_size == 0 || !compare){
+        return NULL;
+    }
+    if (ids > SIZE_MAX / sizeof(size_t) || (ids && key_size > SIZE_MAX / ids)){
+        return NULL;
+    }
+
+    Iheap heap = malloc(sizeof(struct indexed_heap));
+    if (!heap){
+        return NULL;
+    }
+    heap->heap = malloc((ids ? ids : 1) * sizeof(size_t));
+    heap->position = malloc((ids ? ids : 1) * sizeof(size_t));
+    heap->keys = malloc((ids ? ids : 1) * key_size);
+    if (!heap->heap || !heap->position || !heap->keys){
+        free(heap->heap);
+        free(heap->position);
+        free(heap->keys);
+        free(heap);
+        return NULL;
+    }
+
+    for (size_t id = 0; id < ids; id++){
+        heap->position[id] = NOT_IN_HEAP;
+    }
+    heap->count = 0;
+    heap->ids = ids;
+    heap->key_size = key_size;
+    heap->compare = compare;
+
+    return heap;
+}
+
+
+
+void Iheap_destroy(Iheap *heap_ref){
+    if (!(*heap_ref)){
+        return;
+    }
+    free((*heap_ref)->heap);
+    free((*heap_ref)->position);
+    free((*heap_ref)->keys);
+    free(*heap_ref);
+    *heap_ref = NULL;
+}
+
+
+
+size_t Iheap_count(Iheap heap){
+    return heap->count;
+}
+
+
+
+bool Iheap_contains(Iheap heap, size_t id){
+    return id < heap->ids && heap->position[id] != NOT_IN_HEAP;
+}
+
+
+
+const void *Iheap_key(Iheap heap, size_t id){
+    return Iheap_contains(heap, id) ? Iheap_key_of(heap, id) : NULL;
+}
+
+
+
+bool Iheap_set(Iheap heap, size_t id, const void *key){
+    if (id >= heap->ids){
+        return false;
+    }
+    char *id_key = heap->keys + id*heap->key_size;
+    size_t slot = heap->position[id];
+
+    if (slot == NOT_IN_HEAP){
+        memcpy(id_key, key, heap->key_size);
+        heap->count++;
+        Iheap_sift_up(heap, heap->count-1, id);
+        return true;
+    }
+
+    int direction = heap->compare(key, id_key);
+    memmove(id_key, key, heap->key_size);
+    if (direction > 0){
+        Iheap_sift_up(heap, slot, id);
+    }
+    else if (direction < 0){
+        Iheap_sift_down(heap, slot, id);
+    }
+    return true;
+}
+
+
+
+bool Iheap_remove(Iheap heap, size_t id){
+    if (!Iheap_contains(heap, id)){
+        return false;
+    }
+    size_t slot = heap->position[id];
+
+    heap->position[id] = NOT_IN_HEAP;
+    heap->count--;
+    if (slot == heap->count){
+        // it was the last one
+        return true;
+    }
+
+    size_t last_id = heap->heap[heap->count];
+    if (Iheap_sift_up(heap, slot, last_id) == slot){
+        Iheap_sift_down(heap, slot, last_id);
+    }
+    return true;
+}
+
+
+
+const void *Iheap_peek(Iheap heap, size_t *id){
+    if (heap->count == 0){
+        return NULL;
+    }
+    if (id){
+        *id = heap->heap[0];
+    }
+    return Iheap_key_of(heap, heap->heap[0]);
+}
+
+
+
+bool Iheap_pop(Iheap heap, size_t *id, void *key){
+    if (heap->count == 0){
+        return false;
+    }
+    size_t top_id = heap->heap[0];
+
+    if (id){
+        *id = top_id;
+    }
+    if (key){
+        memcpy(key, Iheap_key_of(heap, top_id), heap->key_size);
+    }
+    Iheap_remove(heap, top_id);
+    return true;
+}
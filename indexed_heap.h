@@ -0,0 +1,70 @@
+#ifndef INDEXED_HEAP_H
+#define INDEXED_HEAP_H
+
+/* *********************** Overview ******************* */
+
+/* An indexed (addressable) priority queue, for algorithms such as Dijkstra's
+ * and Prim's that need to change the priority of, or remove, an item that's
+ * already queued.
+ *
+ * Items are identified by an id, from 0 to the number of ids given when the
+ * heap is created, and each id is in the heap at most once, with a key of
+ * key_size bytes. As for Pqueue (priority_queue.h), keys are ordered by a
+ * qsort()-style comparator, and the item whose key compares greatest is at
+ * the top; for a min-queue -- e.g. Dijkstra's distances -- pass a comparator
+ * with its result negated. Decreasing a distance then raises the item in the
+ * heap, as a decrease-key does in a min-heap.
+ *
+ * A map from each id to its place in the heap makes changing a key and
+ * removing an item O(log n), so there's never any need to push duplicates
+ * and skip stale ones when they're popped (lazy deletion): the heap never
+ * holds more than one entry per id.
+ *
+ * All the memory is allocated when the heap is created, so nothing but
+ * Iheap_create() can fail for lack of it.
+ */
+
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "sort_common.h"
+
+
+typedef struct indexed_heap *Iheap;
+
+
+
+/* Create an empty heap for the ids 0 to ids-1, with keys of key_size bytes
+ * each ordered by compare. Returns NULL if the memory couldn't be allocated. */
+Iheap Iheap_create(size_t ids, size_t key_size, Sort_compare_fn compare);
+
+/* Free the heap. *heap_ref is set to NULL. */
+void Iheap_destroy(Iheap *heap_ref);
+
+/* Number of items in the heap */
+size_t Iheap_count(Iheap heap);
+
+/* Whether id is in the heap */
+bool Iheap_contains(Iheap heap, size_t id);
+
+/* The key of id, or NULL if id isn't in the heap. The pointer stays valid, and
+ * the key unchanged, until id's key is next set or id removed. */
+const void *Iheap_key(Iheap heap, size_t id);
+
+/* Add id to the heap with a copy of *key, or if it's already in it, change its
+ * key to *key. Returns false if id is out of range. O(log n) */
+bool Iheap_set(Iheap heap, size_t id, const void *key);
+
+/* Remove id from the heap. Returns false if it isn't in it. O(log n) */
+bool Iheap_remove(Iheap heap, size_t id);
+
+/* The key of the top item, which is left in the heap, or NULL if the heap is
+ * empty. Its id is stored in *id unless id is NULL. */
+const void *Iheap_peek(Iheap heap, size_t *id);
+
+/* Remove the top item, storing its id in *id and copying its key to *key,
+ * unless either is NULL. Returns false if the heap is empty. O(log n) */
+bool Iheap_pop(Iheap heap, size_t *id, void *key);
+
+
+#endif
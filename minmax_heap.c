@@ -0,0 +1,304 @@
+#include "minmax_heap.h"
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+/* ************************************************ */
+/* --------------- IMPLEMENTATION NOTES ------------*/
+/*                      * * *
+    The root is on level 0, its children on level 1, and so on: the node at
+    index i is on level floor(log2(i+1)). Even levels are min levels, odd
+    levels max levels. Every node on a min level is no greater than any of its
+    descendants, and every node on a max level no smaller.
+
+    The min and max cases are the mirror image of each other, so the code is
+    written once, in terms of a level's sign: -1 for a min level, +1 for a max
+    level. Mmheap_above(heap, x, y, sign) tells whether x belongs above y on a
+    level of that sign, i.e. whether x < y on a min level, or x > y on a max
+    level.
+
+                * * *
+    Push: the new element is put at the end, on some level. If it belongs
+    above its parent -- which is on a level of the other sign -- it's moved up
+    to its parent's place and carries on from there. Either way, it then only
+    has to be compared with the nodes on levels of the same sign as its
+    own, i.e. with its grandparent, its grandparent's grandparent, and so on,
+    and is bubbled up that way.
+
+    Pop: the min is the root, and the max the larger of the root's two
+    children (or the root, if it's alone). The last element of the heap takes
+    its place, and is trickled down: at each step, the best of the children
+    and grandchildren of its position (the smallest on a min level) is found,
+    and if it belongs above the element, it's moved up into the element's
+    place.
+    If that was a grandchild, the element now goes down two levels, to the
+    grandchild's place, but could belong above the grandchild's parent, which
+    is on the other kind of level; if so, the two are swapped, and the element
+    that carries on down is the parent. If it was a child, the trickle stops:
+    ties are resolved in favor of the grandchildren, so a child is only picked
+    if it's strictly better than any grandchild, and then it can't have any
+    children of its own.
+
+    As in priority_queue.c, the element being moved is kept aside in the
+    scratch slot, and the nodes it passes over moved into the hole it leaves.
+*  -------------------------------------------------------------- */
+/* ************************************************************** */
+
+
+// capacity of a heap created with a capacity of 0
+#define MMHEAP_DEFAULT_CAPACITY 16
+
+
+struct minmax_heap{
+    char *elements;
+    size_t count;
+    size_t capacity;            // in elements
+    size_t element_size;
+    Sort_compare_fn compare;
+    _Alignas(max_align_t) char scratch[];  // room for one element, being moved; aligned like malloc() memory
+};
+
+
+
+
+
+
+
+/* ********************************************************************************* */
+/* ---------------------------- PRIVATE FUNCTIONS ---------------------------------- */
+
+static inline char *Mmheap_at(Mmheap heap, size_t index){
+    return heap->elements + index*heap->element_size;
+}
+
+
+
+static inline int Mmheap_level_sign(size_t index){
+    /* -1 if index is on a min level, +1 if it's on a max level */
+    unsigned int level = 0;
+
+    for (size_t i = index+1; i > 1; i >>= 1){
+        level++;
+    }
+    return (level & 1) ? 1 : -1;
+}
+
+
+
+static inline bool Mmheap_above(Mmheap heap, const void *x, const void *y, int sign){
+    /* Whether x belongs above y on a level of the given sign */
+    return (sign > 0) ? heap->compare(x, y) > 0 : heap->compare(y, x) > 0;
+}
+
+
+
+static bool Mmheap_reserve(Mmheap heap){
+    /* Make sure there's room for one more element, doubling the capacity
+       if there isn't. */
+    if (heap->count < heap->capacity){
+        return true;
+    }
+    if (heap->capacity > SIZE_MAX / heap->element_size / 2){
+        return false;
+    }
+
+    char *grown = realloc(heap->elements, 2 * heap->capacity * heap->element_size);
+    if (!grown){
+        return false;
+    }
+    heap->elements = grown;
+    heap->capacity *= 2;
+    return true;
+}
+
+
+
+static void Mmheap_bubble_up(Mmheap heap, size_t hole){
+    /* Bubble the element in the scratch slot up from the empty position hole */
+    size_t size = heap->element_size;
+    int sign = Mmheap_level_sign(hole);
+
+    if (hole > 0){
+        size_t parent = (hole-1)>>1;
+        if (Mmheap_above(heap, heap->scratch, Mmheap_at(heap, parent), -sign)){
+            memcpy(Mmheap_at(heap, hole), Mmheap_at(heap, parent), size);
+            hole = parent;
+            sign = -sign;
+        }
+    }
+
+    while (hole > 2){
+        size_t grandparent = (((hole-1)>>1) - 1)>>1;
+        if (!Mmheap_above(heap, heap->scratch, Mmheap_at(heap, grandparent), sign)){
+            break;
+        }
+        memcpy(Mmheap_at(heap, hole), Mmheap_at(heap, grandparent), size);
+        hole = grandparent;
+    }
+    memcpy(Mmheap_at(heap, hole), heap->scratch, size);
+}
+
+
+
+static void Mmheap_trickle_down(Mmheap heap, size_t hole){
+    /* Trickle the element in the scratch slot down from the empty position hole */
+    size_t size = heap->element_size;
+    size_t count = heap->count;
+    int sign = Mmheap_level_sign(hole);
+
+    for (;;){
+        size_t first_child = 1 + (hole<<1);
+        if (first_child >= count){
+            break;
+        }
+
+        // the best of the children and grandchildren; ties go to the grandchildren
+        size_t best = first_child;
+        if (first_child+1 < count && Mmheap_above(heap, Mmheap_at(heap, first_child+1), Mmheap_at(heap, best), sign)){
+            best = first_child+1;
+        }
+        size_t first_grandchild = 1 + (first_child<<1);
+        for (size_t grandchild = first_grandchild; grandchild < first_grandchild+4 && grandchild < count; grandchild++){
+            if (!Mmheap_above(heap, Mmheap_at(heap, best), Mmheap_at(heap, grandchild), sign)){
+                best = grandchild;
+            }
+        }
+
+        if (!Mmheap_above(heap, Mmheap_at(heap, best), heap->scratch, sign)){
+            break;
+        }
+        memcpy(Mmheap_at(heap, hole), Mmheap_at(heap, best), size);
+        hole = best;
+        if (best < first_grandchild){
+            break;
+        }
+
+        size_t parent = (best-1)>>1;
+        if (Mmheap_above(heap, heap->scratch, Mmheap_at(heap, parent), -sign)){
+            Sort_swap_elements(heap->scratch, Mmheap_at(heap, parent), size);
+        }
+    }
+    memcpy(Mmheap_at(heap, hole), heap->scratch, size);
+}
+
+
+
+static void Mmheap_remove_at(Mmheap heap, size_t index, void *element){
+    /* Remove the element at index, which is the min or the max, copying it
+       to *element unless element is NULL */
+    if (element){
+        memcpy(element, Mmheap_at(heap, index), heap->element_size);
+    }
+    heap->count--;
+    if (index == heap->count){
+        return;
+    }
+    memcpy(heap->scratch, Mmheap_at(heap, heap->count), heap->element_size);
+    Mmheap_trickle_down(heap, index);
+}
+
+
+
+static size_t Mmheap_max_index(Mmheap heap){
+    /* Index of the largest element of a non-empty heap */
+    if (heap->count < 3){
+        return heap->count-1;
+    }
+    return (heap->compare(Mmheap_at(heap, 2), Mmheap_at(heap, 1)) > 0) ? 2 : 1;
+}
+
+/* ------------------------------- END PRIVATE ------------------------------------- */
+/* ********************************************************************************* */
+
+
+
+
+Mmheap Mmheap_create(size_t element_size, size_t capacity, Sort_compare_fn compare){
+    if (element_size == 0 || !compare){
+        return NULL;
+    }
+    if (capacity == 0){
+        capacity = MMHEAP_DEFAULT_CAPACITY;
+    }
+    if (capacity > SIZE_MAX / element_size){
+        return NULL;
+    }
+
+    Mmheap heap = malloc(sizeof(struct minmax_heap) + element_size);
+    if (!heap){
+        return NULL;
+    }
+    heap->elements = malloc(capacity * element_size);
+    if (!heap->elements){
+        free(heap);
+        return NULL;
+    }
+    heap->count = 0;
+    heap->capacity = capacity;
+    heap->element_size = element_size;
+    heap->compare = compare;
+
+    return heap;
+}
+
+
+
+void Mmheap_destroy(Mmheap *heap_ref){
+    if (!(*heap_ref)){
+        return;
+    }
+    free((*heap_ref)->elements);
+    free(*heap_ref);
+    *heap_ref = NULL;
+}
+
+
+
+size_t Mmheap_count(Mmheap heap){
+    return heap->count;
+}
+
+
+
+bool Mmheap_push(Mmheap heap, const void *element){
+    memcpy(heap->scratch, element, heap->element_size);
+    if (!Mmheap_reserve(heap)){
+        return false;
+    }
+    heap->count++;
+    Mmheap_bubble_up(heap, heap->count-1);
+    return true;
+}
+
+
+
+const void *Mmheap_peek_min(Mmheap heap){
+    return heap->count ? heap->elements : NULL;
+}
+
+
+
+const void *Mmheap_peek_max(Mmheap heap){
+    return heap->count ? Mmheap_at(heap, Mmheap_max_index(heap)) : NULL;
+}
+
+
+
+bool Mmheap_pop_min(Mmheap heap, void *element){
+    if (heap->count == 0){
+        return false;
+    }
+    Mmheap_remove_at(heap, 0, element);
+    return true;
+}
+
+
+
+bool Mmheap_pop_max(Mmheap heap, void *element){
+    if (heap->count == 0){
+        return false;
+    }
+    Mmheap_remove_at(heap, Mmheap_max_index(heap), element);
+    return true;
+}
@@ -0,0 +1,57 @@
+#ifndef MINMAX_HEAP_H
+#define MINMAX_HEAP_H
+
+/* *********************** Overview ******************* */
+
+/* A double-ended priority queue, stored as a min-max heap: an implicit heap,
+ * laid out in an array as the max heap of heapsort.c, whose levels are
+ * alternately ordered as a min heap and as a max heap.
+ *
+ * Every node on an even level (the root's, 0) is the smallest element of its
+ * subtree, and every node on an odd level the largest, so the smallest
+ * element of the whole heap is the root, and the largest is one of its two
+ * children. Both are found in O(1) time, and either can be removed in
+ * O(log n) time, with a single heap holding each element once.
+ *
+ * Elements are handled as in Pqueue (priority_queue.h): they're of any fixed
+ * size, copied in and out, ordered by a qsort()-style comparator, and kept in
+ * storage that doubles whenever it fills up. Functions that may need to
+ * allocate return false, and leave the heap as it was, if that fails.
+ */
+
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "sort_common.h"
+
+
+typedef struct minmax_heap *Mmheap;
+
+
+
+/* Create an empty heap of elements of element_size bytes each, ordered by
+ * compare, with room for capacity elements before it has to grow (0 for a
+ * default). Returns NULL if the memory couldn't be allocated. */
+Mmheap Mmheap_create(size_t element_size, size_t capacity, Sort_compare_fn compare);
+
+/* Free the heap and everything in it. *heap_ref is set to NULL. */
+void Mmheap_destroy(Mmheap *heap_ref);
+
+/* Number of elements in the heap */
+size_t Mmheap_count(Mmheap heap);
+
+/* Add a copy of *element to the heap. O(log n) */
+bool Mmheap_push(Mmheap heap, const void *element);
+
+/* The smallest and the largest elements, left in the heap, or NULL if it's
+ * empty. The pointers are only valid until the heap is next changed. O(1) */
+const void *Mmheap_peek_min(Mmheap heap);
+const void *Mmheap_peek_max(Mmheap heap);
+
+/* Remove the smallest or the largest element, copying it to *element unless
+ * element is NULL. Return false if the heap is empty. O(log n) */
+bool Mmheap_pop_min(Mmheap heap, void *element);
+bool Mmheap_pop_max(Mmheap heap, void *element);
+
+
+#endif
@@ -0,0 +1,295 @@
+#include "priority_queue.h"
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+/* ************************************************ */
+/* --------------- IMPLEMENTATION NOTES ------------*/
+/*                      * * *
+    The heap is laid out as in heapsort.c: the root at index 0, and the
+    children of the node at index i at 2i+1 and 2i+2. Unlike that one, it
+    owns its array, and grows it by doubling its capacity when it's full.
+
+    Queues created by Pqueue_create_dary() have 4 or 8 children per node
+    instead, at di+1 to di+d, as in Heap_sort_dary(). The arity being a power
+    of two, the index arithmetic is done with shifts by log_arity.
+    Sift ups get shorter, as the heap is shallower, and so do sift downs,
+    which compare more children per level, but read them from one or two
+    cache lines rather than from one line per level.
+
+    Elements are opaque blocks of element_size bytes, so moving one is a
+    memcpy(). Sifting an element up or down swaps it with a parent or child at
+    every level, which would be 3 copies per level; the sifts here instead
+    keep the element being sifted aside, in the queue's scratch slot, and move
+    the parents or children into the hole it left, one copy per level. The
+    element is copied into the final position of the hole at the end.
+
+    Pushing an element already in the queue -- e.g. the one Pqueue_peek()
+    points to -- is safe, as it's copied to the scratch slot before the array
+    is changed or reallocated.
+
+                * * *
+    Bulk insertion (Pqueue_push_all()) appends the new elements to the array,
+    and then either sifts each of them up, as a push would, in O(m log n)
+    time, or rebuilds the whole heap bottom-up as Heap_max_heapify_bu() does,
+    in O(n+m) time, sifting down every non-leaf node from the last one back to
+    the root. The rebuild is used once the new elements are at least as many
+    as those already in the heap.
+*  -------------------------------------------------------------- */
+/* ************************************************************** */
+
+
+// capacity of a queue created with a capacity of 0
+#define PQUEUE_DEFAULT_CAPACITY 16
+
+
+struct priority_queue{
+    char *elements;
+    size_t count;
+    size_t capacity;            // in elements
+    size_t element_size;
+    Sort_compare_fn compare;
+    unsigned int log_arity;     // every node has 2^log_arity children
+    _Alignas(max_align_t) char scratch[];  // room for one element, being sifted; aligned like malloc() memory
+};
+
+
+
+
+
+
+
+/* ********************************************************************************* */
+/* ---------------------------- PRIVATE FUNCTIONS ---------------------------------- */
+
+static inline char *Pqueue_at(Pqueue queue, size_t index){
+    return queue->elements + index*queue->element_size;
+}
+
+
+
+static bool Pqueue_reserve(Pqueue queue, size_t extra){
+    /* Make sure there's room for extra more elements, doubling the capacity
+       (more than once if need be) if there isn't. */
+    if (extra <= queue->capacity - queue->count){
+        return true;
+    }
+    if (extra > SIZE_MAX / queue->element_size - queue->count){
+        return false;
+    }
+
+    size_t needed = queue->count + extra;
+    size_t capacity = queue->capacity;
+    while (capacity < needed){
+        capacity = (capacity > SIZE_MAX / queue->element_size / 2) ? needed : 2*capacity;
+    }
+
+    char *grown = realloc(queue->elements, capacity * queue->element_size);
+    if (!grown){
+        return false;
+    }
+    queue->elements = grown;
+    queue->capacity = capacity;
+    return true;
+}
+
+
+
+static void Pqueue_sift_up(Pqueue queue, size_t hole){
+    /* Sift the element in the scratch slot up from the empty position hole */
+    size_t size = queue->element_size;
+
+    while (hole > 0){
+        size_t parent = (hole-1) >> queue->log_arity;
+        if (queue->compare(Pqueue_at(queue, parent), queue->scratch) >= 0){
+            break;
+        }
+        memcpy(Pqueue_at(queue, hole), Pqueue_at(queue, parent), size);
+        hole = parent;
+    }
+    memcpy(Pqueue_at(queue, hole), queue->scratch, size);
+}
+
+
+
+static void Pqueue_sift_down(Pqueue queue, size_t hole){
+    /* Sift the element in the scratch slot down from the empty position hole */
+    size_t size = queue->element_size;
+    size_t count = queue->count;
+    unsigned int log_arity = queue->log_arity;
+
+    if (count < 2){
+        memcpy(Pqueue_at(queue, hole), queue->scratch, size);
+        return;
+    }
+    size_t last_parent = (count-2) >> log_arity;
+
+    while (hole <= last_parent){
+        size_t first_child = (hole << log_arity) + 1;
+        size_t end_child = first_child + ((size_t)1 << log_arity);
+        size_t child = first_child;
+
+        // the largest of the children
+        if (end_child > count){
+            end_child = count;
+        }
+        for (size_t other = first_child+1; other < end_child; other++){
+            if (queue->compare(Pqueue_at(queue, other), Pqueue_at(queue, child)) > 0){
+                child = other;
+            }
+        }
+        if (queue->compare(Pqueue_at(queue, child), queue->scratch) <= 0){
+            break;
+        }
+        memcpy(Pqueue_at(queue, hole), Pqueue_at(queue, child), size);
+        hole = child;
+    }
+    memcpy(Pqueue_at(queue, hole), queue->scratch, size);
+}
+
+/* ------------------------------- END PRIVATE ------------------------------------- */
+/* ********************************************************************************* */
+
+
+
+
+Pqueue Pqueue_create(size_t element_size, size_t capacity, Sort_compare_fn compare){
+    return Pqueue_create_dary(element_size, capacity, compare, 2);
+}
+
+
+
+Pqueue Pqueue_create_dary(size_t element_size, size_t capacity, Sort_compare_fn compare, unsigned int arity){
+    unsigned int log_arity;
+
+    switch (arity){
+        case 2: log_arity = 1; break;
+        case 4: log_arity = 2; break;
+        case 8: log_arity = 3; break;
+        default: return NULL;
+    }
+    if (element_size == 0 || !compare){
+        return NULL;
+    }
+    if (capacity == 0){
+        capacity = PQUEUE_DEFAULT_CAPACITY;
+    }
+    if (capacity > SIZE_MAX / element_size){
+        return NULL;
+    }
+
+    Pqueue queue = malloc(sizeof(struct priority_queue) + element_size);
+    if (!queue){
+        return NULL;
+    }
+    queue->elements = malloc(capacity * element_size);
+    if (!queue->elements){
+        free(queue);
+        return NULL;
+    }
+    queue->count = 0;
+    queue->capacity = capacity;
+    queue->element_size = element_size;
+    queue->compare = compare;
+    queue->log_arity = log_arity;
+
+    return queue;
+}
+
+
+
+void Pqueue_destroy(Pqueue *queue_ref){
+    if (!(*queue_ref)){
+        return;
+    }
+    free((*queue_ref)->elements);
+    free(*queue_ref);
+    *queue_ref = NULL;
+}
+
+
+
+size_t Pqueue_count(Pqueue queue){
+    return queue->count;
+}
+
+
+
+bool Pqueue_push(Pqueue queue, const void *element){
+    memcpy(queue->scratch, element, queue->element_size);
+    if (!Pqueue_reserve(queue, 1)){
+        return false;
+    }
+    queue->count++;
+    Pqueue_sift_up(queue, queue->count-1);
+    return true;
+}
+
+
+
+bool Pqueue_push_all(Pqueue queue, const void *elements, size_t count){
+    size_t old_count = queue->count;
+
+    if (count == 0){
+        return true;
+    }
+    if (!Pqueue_reserve(queue, count)){
+        return false;
+    }
+    memcpy(Pqueue_at(queue, old_count), elements, count * queue->element_size);
+    queue->count += count;
+
+    if (count < old_count){
+        for (size_t i = old_count; i < queue->count; i++){
+            memcpy(queue->scratch, Pqueue_at(queue, i), queue->element_size);
+            Pqueue_sift_up(queue, i);
+        }
+        return true;
+    }
+
+    // bottom-up rebuild, as in Heap_max_heapify_bu()
+    size_t non_leaves = (queue->count < 2) ? 0 : ((queue->count-2) >> queue->log_arity) + 1;
+    for (size_t non_leaf = non_leaves; non_leaf-- > 0;){
+        memcpy(queue->scratch, Pqueue_at(queue, non_leaf), queue->element_size);
+        Pqueue_sift_down(queue, non_leaf);
+    }
+    return true;
+}
+
+
+
+const void *Pqueue_peek(Pqueue queue){
+    return queue->count ? queue->elements : NULL;
+}
+
+
+
+bool Pqueue_pop(Pqueue queue, void *top){
+    if (queue->count == 0){
+        return false;
+    }
+    if (top){
+        memcpy(top, queue->elements, queue->element_size);
+    }
+    queue->count--;
+    if (queue->count){
+        memcpy(queue->scratch, Pqueue_at(queue, queue->count), queue->element_size);
+        Pqueue_sift_down(queue, 0);
+    }
+    return true;
+}
+
+
+
+bool Pqueue_replace_top(Pqueue queue, const void *element, void *top){
+    if (queue->count == 0){
+        return false;
+    }
+    memcpy(queue->scratch, element, queue->element_size);
+    if (top){
+        memcpy(top, queue->elements, queue->element_size);
+    }
+    Pqueue_sift_down(queue, 0);
+    return true;
+}
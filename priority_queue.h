@@ -0,0 +1,71 @@
+#ifndef PRIORITY_QUEUE_H
+#define PRIORITY_QUEUE_H
+
+/* *********************** Overview ******************* */
+
+/* A growable priority queue, stored as an implicit max heap in an array, the
+ * same way as the heap of heapsort.c.
+ *
+ * Elements are of any fixed size, given when the queue is created, and are
+ * copied in and out of the queue. The order is set by a comparator with the
+ * qsort() contract: the element that compares greatest is at the top. For
+ * a min-queue, pass a comparator with its result negated.
+ *
+ * The storage doubles whenever it fills up, so pushes take amortized O(1)
+ * time on top of the O(log n) sift.
+ * Functions that may need to allocate return false, and leave the queue as it
+ * was, if that fails.
+ */
+
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "sort_common.h"
+
+
+typedef struct priority_queue *Pqueue;
+
+
+
+/* Create an empty queue of elements of element_size bytes each, ordered by
+ * compare, with room for capacity elements before it has to grow (0 for a
+ * default). Returns NULL if the memory couldn't be allocated. */
+Pqueue Pqueue_create(size_t element_size, size_t capacity, Sort_compare_fn compare);
+
+/* Same as Pqueue_create(), for a d-ary heap: every node has arity children,
+ * rather than 2. arity is 2, 4 or 8; NULL is returned for anything else.
+ * The wider heaps are shallower, and faster once they outgrow the cache,
+ * as a node's children are read from one or two cache lines. */
+Pqueue Pqueue_create_dary(size_t element_size, size_t capacity, Sort_compare_fn compare, unsigned int arity);
+
+/* Free the queue and everything in it. *queue_ref is set to NULL. */
+void Pqueue_destroy(Pqueue *queue_ref);
+
+/* Number of elements in the queue */
+size_t Pqueue_count(Pqueue queue);
+
+/* Add a copy of *element to the queue. O(log n) */
+bool Pqueue_push(Pqueue queue, const void *element);
+
+/* Add copies of the count elements starting at elements to the queue.
+ * When they're at least as many as the elements already in it, the heap is
+ * rebuilt bottom-up around them in O(n) time, rather than sifting them in one
+ * by one, so pushing an array into an empty queue is the way to build a queue
+ * from it. elements must not point into the queue itself. */
+bool Pqueue_push_all(Pqueue queue, const void *elements, size_t count);
+
+/* The top element, left in the queue, or NULL if it's empty. The pointer is
+ * only valid until the queue is next changed. */
+const void *Pqueue_peek(Pqueue queue);
+
+/* Remove the top element, copying it to *top unless top is NULL.
+ * Returns false if the queue is empty. O(log n) */
+bool Pqueue_pop(Pqueue queue, void *top);
+
+/* Replace the top element with a copy of *element: same as a pop followed by
+ * a push, but with a single sift. The old top is copied to *top unless top is
+ * NULL. Returns false, without pushing, if the queue is empty. O(log n) */
+bool Pqueue_replace_top(Pqueue queue, const void *element, void *top);
+
+
+#endif
@@ -0,0 +1,508 @@
+#include "radixsort.h"
+#include "sort_typed.h"
+#include "work_pool.h"
+#include <stdlib.h>
+#include <string.h>
+
+
+/* ************************************************ */
+/* --------------- IMPLEMENTATION NOTES ------------*/
+/*                      * * *
+    Keys and digits.
+    Radix sorting orders keys by the unsigned value of their bits. That's
+    the right order for unsigned integers, but not for the other types, so
+    every key is first mapped to an unsigned integer of the same width
+    whose order is the order of the original type (Radix_key_<suffix>()):
+     - signed integers: flipping the sign bit moves the negative values,
+       in order, below the positive ones;
+     - floats: for positive values (sign bit clear), the IEEE 754 bit patterns
+       are already in the right order, and setting the sign bit puts them above
+       all the negative ones. For negative values, the bit patterns grow with
+       the magnitude, so all the bits are flipped. NaNs are all mapped to the
+       largest key, which puts them last.
+    The mapping is applied on the fly whenever a digit is extracted; the
+    keys themselves are moved around unchanged.
+    The digits are the bytes of the mapped key: 4 for 32-bit keys, 8 for
+    64-bit ones.
+
+                * * *
+    LSD (least significant digit first) radix sort.
+    One pass per digit, from the lowest to the highest, distributes the keys
+    from one buffer to the other, into 256 buckets by the value of that digit.
+    Each pass is stable, so after the last one, the keys are ordered by all
+    the digits. The array and the scratch buffer take turns being the source
+    and the destination.
+
+    Where each bucket starts in the destination comes from a histogram of the
+    digit's values. The histograms for all the digits are computed at once, in a
+    single pass over the keys before the first distribution pass, since
+    distributing doesn't change which digit values occur.
+    A digit for which every key falls in the same bucket -- e.g. the high
+    bytes of small integers -- would just copy the keys over, so its pass is
+    skipped altogether.
+
+                * * *
+    Parallel LSD radix sort.
+    Same passes as the LSD radix sort, each one split across the threads
+    of a WorkPool: the source is cut into one contiguous chunk per thread,
+    and every pass runs in two parallel phases, with a short sequential step
+    in between:
+     1. each thread builds a private histogram of the digit over its chunk;
+     2. a prefix sum over the buckets, and within each bucket over the chunks
+        in order, gives every chunk its own start position in each bucket.
+        Keeping the chunks in order within the buckets keeps the pass stable;
+     3. each thread scatters its chunk to its positions. No two threads ever
+        write to the same place, so nothing but the waits between phases has
+        to be synchronized.
+    The histograms can't all be built up front as in the sequential sort:
+    which keys fall in which chunk changes with every pass.
+
+    Scattering writes to 256 places at once all over the destination, which
+    thrashes the TLB and makes every key written a read-for-ownership of its
+    cache line. So the keys are staged in small per-bucket buffers of a cache
+    line each (write-combining buffers, on the stack of the thread), and
+    copied to the destination a full line at a time. The first copy for each
+    bucket only fills up the line its start position falls in, so that the
+    following ones each cover exactly one cache line of the destination.
+
+                * * *
+    In-place MSD (most significant digit first) radix sort, a.k.a. American
+    flag sort.
+    The range is distributed into 256 buckets by its highest digit, then each
+    bucket is sorted the same way by the next digit, recursively.
+    The distribution is done in place: a histogram gives each bucket's
+    boundaries, and a "next free slot" pointer is kept for each bucket. Going
+    over the buckets in order, the key at the next free slot of the current
+    bucket is taken out, and swapped into the next free slot of the bucket it
+    belongs to, and the key taken out from there into its own bucket, and so on,
+    until a key that belongs in the current bucket comes up, closing the cycle.
+    Every swap puts one key in its final bucket, so each key is moved at
+    most once per digit.
+    Buckets below RADIX_MSD_CUTOFF keys aren't worth another histogram pass
+    (which costs at least 256 operations on its own) and are sorted by the
+    typed quicksort, which finishes small ranges off with insertion sort.
+    The recursion is only as deep as a key has digits, 8 at most, so the only
+    memory used on top of the array is a bounded amount of stack: two 256-entry
+    tables per level.
+*  -------------------------------------------------------------- */
+/* ************************************************************** */
+
+
+
+
+/* ********************************************************************************* */
+/* ---------------------------- PRIVATE FUNCTIONS ---------------------------------- */
+
+static inline uint32_t Radix_key_u32(uint32_t key){
+    return key;
+}
+
+static inline uint32_t Radix_key_i32(int32_t key){
+    return (uint32_t)key ^ UINT32_C(0x80000000);
+}
+
+static inline uint32_t Radix_key_f32(float key){
+    uint32_t bits;
+
+    if (key != key){
+        return UINT32_MAX;
+    }
+    memcpy(&bits, &key, sizeof(bits));
+    return (bits & UINT32_C(0x80000000)) ? ~bits : (bits | UINT32_C(0x80000000));
+}
+
+static inline uint64_t Radix_key_u64(uint64_t key){
+    return key;
+}
+
+static inline uint64_t Radix_key_i64(int64_t key){
+    return (uint64_t)key ^ UINT64_C(0x8000000000000000);
+}
+
+static inline uint64_t Radix_key_f64(double key){
+    uint64_t bits;
+
+    if (key != key){
+        return UINT64_MAX;
+    }
+    memcpy(&bits, &key, sizeof(bits));
+    return (bits & UINT64_C(0x8000000000000000)) ? ~bits : (bits | UINT64_C(0x8000000000000000));
+}
+
+
+
+/* Generates Radix_lsd_<suffix>(array, buffer, count), which sorts array using
+   buffer, of the same size, as scratch space. The sorted keys end up in array. */
+#define RADIX_DEFINE_LSD(suffix, type, key_type) \
+static void Radix_lsd_##suffix(type array[], type buffer[], size_t count){ \
+    enum { DIGITS = sizeof(key_type) }; \
+    size_t counts[DIGITS][256] = {{0}}; \
+    \
+    for (size_t i = 0; i < count; i++){ \
+        key_type key = Radix_key_##suffix(array[i]); \
+        for (unsigned int digit = 0; digit < DIGITS; digit++){ \
+            counts[digit][(key >> (8*digit)) & 0xFF]++; \
+        } \
+    } \
+    \
+    type *source = array; \
+    type *destination = buffer; \
+    key_type first_key = Radix_key_##suffix(array[0]); \
+    \
+    for (unsigned int digit = 0; digit < DIGITS; digit++){ \
+        unsigned int shift = 8*digit; \
+        \
+        if (counts[digit][(first_key >> shift) & 0xFF] == count){ \
+            continue; \
+        } \
+        \
+        /* bucket sizes to bucket start positions */ \
+        size_t position = 0; \
+        for (unsigned int bucket = 0; bucket < 256; bucket++){ \
+            size_t bucket_size = counts[digit][bucket]; \
+            counts[digit][bucket] = position; \
+            position += bucket_size; \
+        } \
+        \
+        for (size_t i = 0; i < count; i++){ \
+            type value = source[i]; \
+            destination[counts[digit][(Radix_key_##suffix(value) >> shift) & 0xFF]++] = value; \
+        } \
+        \
+        type *swap = source; \
+        source = destination; \
+        destination = swap; \
+    } \
+    \
+    if (source != array){ \
+        memcpy(array, source, count * sizeof(type)); \
+    } \
+}
+
+RADIX_DEFINE_LSD(u32, uint32_t, uint32_t)
+RADIX_DEFINE_LSD(i32, int32_t, uint32_t)
+RADIX_DEFINE_LSD(f32, float, uint32_t)
+RADIX_DEFINE_LSD(u64, uint64_t, uint64_t)
+RADIX_DEFINE_LSD(i64, int64_t, uint64_t)
+RADIX_DEFINE_LSD(f64, double, uint64_t)
+
+
+
+// bytes staged per bucket by the parallel scatter before writing them out: a cache line
+#define RADIX_STAGING_BYTES 64
+
+struct radix_parallel_job{
+    void *source;
+    void *destination;
+    size_t count;
+    size_t chunks;              // one per thread
+    unsigned int shift;         // of the digit being distributed
+    size_t (*positions)[256];   // per chunk: bucket sizes, then where it writes each bucket
+};
+
+
+static void Radix_chunk_bounds(const struct radix_parallel_job *job, size_t chunk, size_t *start, size_t *end){
+    *start = job->count / job->chunks * chunk;
+    *end = (chunk == job->chunks-1) ? job->count : *start + job->count / job->chunks;
+}
+
+
+/* Generates, for the parallel LSD radix sort:
+    - Radix_histogram_task_<suffix>() and Radix_scatter_task_<suffix>(), the
+      two parallel phases of a pass over one chunk;
+    - Radix_lsd_parallel_<suffix>(pool, array, buffer, count), which sorts
+      array using buffer, of the same size, as scratch space. */
+#define RADIX_DEFINE_LSD_PARALLEL(suffix, type, key_type) \
+static void Radix_histogram_task_##suffix(WorkPool pool, void *context, size_t chunk, size_t unused){ \
+    struct radix_parallel_job *job = context; \
+    const type *source = job->source; \
+    size_t *counts = job->positions[chunk]; \
+    size_t start, end; \
+    (void)pool; \
+    (void)unused; \
+    \
+    Radix_chunk_bounds(job, chunk, &start, &end); \
+    memset(counts, 0, 256 * sizeof(size_t)); \
+    for (size_t i = start; i < end; i++){ \
+        counts[(Radix_key_##suffix(source[i]) >> job->shift) & 0xFF]++; \
+    } \
+} \
+\
+static void Radix_scatter_task_##suffix(WorkPool pool, void *context, size_t chunk, size_t unused){ \
+    enum { STAGED = RADIX_STAGING_BYTES / sizeof(type) }; \
+    struct radix_parallel_job *job = context; \
+    const type *source = job->source; \
+    type *destination = job->destination; \
+    size_t *positions = job->positions[chunk]; \
+    _Alignas(RADIX_STAGING_BYTES) type staging[256][STAGED]; \
+    unsigned int staged[256] = {0}; \
+    unsigned int room[256]; \
+    size_t start, end; \
+    (void)pool; \
+    (void)unused; \
+    \
+    /* the first flush of a bucket only goes up to the next cache line \
+       boundary of the destination, so that the later ones are aligned */ \
+    for (unsigned int bucket = 0; bucket < 256; bucket++){ \
+        uintptr_t misalignment = (uintptr_t)(destination + positions[bucket]) % RADIX_STAGING_BYTES; \
+        room[bucket] = STAGED - (unsigned int)(misalignment / sizeof(type)); \
+    } \
+    \
+    Radix_chunk_bounds(job, chunk, &start, &end); \
+    for (size_t i = start; i < end; i++){ \
+        type value = source[i]; \
+        unsigned int bucket = (Radix_key_##suffix(value) >> job->shift) & 0xFF; \
+        \
+        staging[bucket][staged[bucket]++] = value; \
+        if (staged[bucket] == room[bucket]){ \
+            if (room[bucket] == STAGED){ \
+                memcpy(destination + positions[bucket], staging[bucket], sizeof(staging[bucket])); \
+            } \
+            else{ \
+                memcpy(destination + positions[bucket], staging[bucket], room[bucket] * sizeof(type)); \
+                room[bucket] = STAGED; \
+            } \
+            positions[bucket] += staged[bucket]; \
+            staged[bucket] = 0; \
+        } \
+    } \
+    for (unsigned int bucket = 0; bucket < 256; bucket++){ \
+        memcpy(destination + positions[bucket], staging[bucket], staged[bucket] * sizeof(type)); \
+    } \
+} \
+\
+static void Radix_lsd_parallel_##suffix(WorkPool pool, type array[], type buffer[], size_t count, size_t (*positions)[256]){ \
+    struct radix_parallel_job job = {array, buffer, count, Pool_threads(pool), 0, positions}; \
+    key_type first_key = Radix_key_##suffix(array[0]); \
+    \
+    for (unsigned int digit = 0; digit < sizeof(key_type); digit++){ \
+        job.shift = 8*digit; \
+        \
+        for (size_t chunk = 0; chunk < job.chunks; chunk++){ \
+            Pool_submit(pool, Radix_histogram_task_##suffix, &job, chunk, 0); \
+        } \
+        Pool_wait(pool); \
+        \
+        /* the keys only get moved around, so first_key is still in the source */ \
+        size_t first_bucket_size = 0; \
+        for (size_t chunk = 0; chunk < job.chunks; chunk++){ \
+            first_bucket_size += positions[chunk][(first_key >> job.shift) & 0xFF]; \
+        } \
+        if (first_bucket_size == count){ \
+            continue; \
+        } \
+        \
+        size_t position = 0; \
+        for (unsigned int bucket = 0; bucket < 256; bucket++){ \
+            for (size_t chunk = 0; chunk < job.chunks; chunk++){ \
+                size_t chunk_bucket_size = positions[chunk][bucket]; \
+                positions[chunk][bucket] = position; \
+                position += chunk_bucket_size; \
+            } \
+        } \
+        \
+        for (size_t chunk = 0; chunk < job.chunks; chunk++){ \
+            Pool_submit(pool, Radix_scatter_task_##suffix, &job, chunk, 0); \
+        } \
+        Pool_wait(pool); \
+        \
+        void *swap = job.source; \
+        job.source = job.destination; \
+        job.destination = swap; \
+    } \
+    \
+    if (job.source != array){ \
+        memcpy(array, job.source, count * sizeof(type)); \
+    } \
+}
+
+RADIX_DEFINE_LSD_PARALLEL(u32, uint32_t, uint32_t)
+RADIX_DEFINE_LSD_PARALLEL(i32, int32_t, uint32_t)
+RADIX_DEFINE_LSD_PARALLEL(f32, float, uint32_t)
+RADIX_DEFINE_LSD_PARALLEL(u64, uint64_t, uint64_t)
+RADIX_DEFINE_LSD_PARALLEL(i64, int64_t, uint64_t)
+RADIX_DEFINE_LSD_PARALLEL(f64, double, uint64_t)
+
+
+
+// buckets smaller than this are left to the typed quicksort by the MSD radix sort
+#define RADIX_MSD_CUTOFF 256
+
+/* Generates Radix_msd_<suffix>(array, count, digit), which sorts array in
+   place by its digits from digit down to 0. */
+#define RADIX_DEFINE_MSD(suffix, type, key_type) \
+static void Radix_msd_##suffix(type array[], size_t count, unsigned int digit){ \
+    if (count < RADIX_MSD_CUTOFF){ \
+        Sort_quicksort_##suffix(array, count); \
+        return; \
+    } \
+    \
+    unsigned int shift = 8*digit; \
+    size_t next_free[256] = {0}; \
+    size_t bucket_end[256]; \
+    \
+    for (size_t i = 0; i < count; i++){ \
+        next_free[(Radix_key_##suffix(array[i]) >> shift) & 0xFF]++; \
+    } \
+    \
+    /* every key has the same digit: nothing to distribute */ \
+    if (next_free[(Radix_key_##suffix(array[0]) >> shift) & 0xFF] == count){ \
+        if (digit > 0){ \
+            Radix_msd_##suffix(array, count, digit-1); \
+        } \
+        return; \
+    } \
+    \
+    size_t position = 0; \
+    for (unsigned int bucket = 0; bucket < 256; bucket++){ \
+        size_t bucket_size = next_free[bucket]; \
+        next_free[bucket] = position; \
+        position += bucket_size; \
+        bucket_end[bucket] = position; \
+    } \
+    \
+    for (unsigned int bucket = 0; bucket < 256; bucket++){ \
+        while (next_free[bucket] < bucket_end[bucket]){ \
+            type value = array[next_free[bucket]]; \
+            unsigned int value_bucket = (Radix_key_##suffix(value) >> shift) & 0xFF; \
+            \
+            while (value_bucket != bucket){ \
+                type displaced = array[next_free[value_bucket]]; \
+                array[next_free[value_bucket]++] = value; \
+                value = displaced; \
+                value_bucket = (Radix_key_##suffix(value) >> shift) & 0xFF; \
+            } \
+            array[next_free[bucket]++] = value; \
+        } \
+    } \
+    \
+    if (digit == 0){ \
+        return; \
+    } \
+    size_t bucket_start = 0; \
+    for (unsigned int bucket = 0; bucket < 256; bucket++){ \
+        Radix_msd_##suffix(array + bucket_start, bucket_end[bucket] - bucket_start, digit-1); \
+        bucket_start = bucket_end[bucket]; \
+    } \
+}
+
+RADIX_DEFINE_MSD(u32, uint32_t, uint32_t)
+RADIX_DEFINE_MSD(i32, int32_t, uint32_t)
+RADIX_DEFINE_MSD(f32, float, uint32_t)
+RADIX_DEFINE_MSD(u64, uint64_t, uint64_t)
+RADIX_DEFINE_MSD(i64, int64_t, uint64_t)
+RADIX_DEFINE_MSD(f64, double, uint64_t)
+
+
+
+/* Generates Move_nans_last_<suffix>(), which moves the NaNs to the end of the
+   array, ahead of the in-place radix sort */
+#define RADIX_DEFINE_MOVE_NANS(suffix, type) \
+static size_t Move_nans_last_##suffix(type array[], size_t count){ \
+    size_t numbers = 0; \
+    for (size_t i = 0; i < count; i++){ \
+        if (array[i] == array[i]){ \
+            type temp = array[numbers]; \
+            array[numbers++] = array[i]; \
+            array[i] = temp; \
+        } \
+    } \
+    return numbers; \
+}
+
+RADIX_DEFINE_MOVE_NANS(f32, float)
+RADIX_DEFINE_MOVE_NANS(f64, double)
+
+/* ------------------------------- END PRIVATE ------------------------------------- */
+/* ********************************************************************************* */
+
+
+
+
+/* Generates the public Radix_sort_<suffix>() functions.
+   Without memory for the buffer, the in-place MSD radix sort is used instead,
+   which needs none and still runs in linear time on duplicate-heavy keys. */
+#define RADIX_DEFINE_SORT(suffix, type) \
+void Radix_sort_##suffix(type array[], size_t count){ \
+    if (count < 2){ \
+        return; \
+    } \
+    type *buffer = malloc(count * sizeof(type)); \
+    if (!buffer){ \
+        Radix_sort_inplace_##suffix(array, count); \
+        return; \
+    } \
+    Radix_lsd_##suffix(array, buffer, count); \
+    free(buffer); \
+}
+
+RADIX_DEFINE_SORT(u32, uint32_t)
+RADIX_DEFINE_SORT(i32, int32_t)
+RADIX_DEFINE_SORT(f32, float)
+RADIX_DEFINE_SORT(u64, uint64_t)
+RADIX_DEFINE_SORT(i64, int64_t)
+RADIX_DEFINE_SORT(f64, double)
+
+
+
+// below this many keys, the parallel radix sort just runs the sequential one
+#define RADIX_PARALLEL_CUTOFF (1u << 18)
+
+/* Generates the public Radix_sort_parallel_<suffix>() functions.
+   The buffer is allocated first, so that if the threads can't be set up, the
+   sequential sort can use it rather than allocate a second one. */
+#define RADIX_DEFINE_SORT_PARALLEL(suffix, type) \
+void Radix_sort_parallel_##suffix(type array[], size_t count, unsigned int threads){ \
+    if (threads == 1 || count < RADIX_PARALLEL_CUTOFF){ \
+        Radix_sort_##suffix(array, count); \
+        return; \
+    } \
+    \
+    type *buffer = malloc(count * sizeof(type)); \
+    if (!buffer){ \
+        Radix_sort_inplace_##suffix(array, count); \
+        return; \
+    } \
+    WorkPool pool = Pool_create(threads); \
+    size_t (*positions)[256] = pool ? malloc(Pool_threads(pool) * sizeof(size_t [256])) : NULL; \
+    \
+    if (positions){ \
+        Radix_lsd_parallel_##suffix(pool, array, buffer, count, positions); \
+        free(positions); \
+    } \
+    else{ \
+        /* no threads: sort sequentially, reusing the buffer already held */ \
+        Pool_destroy(&pool); \
+        Radix_lsd_##suffix(array, buffer, count); \
+    } \
+    free(buffer); \
+    Pool_destroy(&pool); \
+}
+
+RADIX_DEFINE_SORT_PARALLEL(u32, uint32_t)
+RADIX_DEFINE_SORT_PARALLEL(i32, int32_t)
+RADIX_DEFINE_SORT_PARALLEL(f32, float)
+RADIX_DEFINE_SORT_PARALLEL(u64, uint64_t)
+RADIX_DEFINE_SORT_PARALLEL(i64, int64_t)
+RADIX_DEFINE_SORT_PARALLEL(f64, double)
+
+
+
+/* Generates the public Radix_sort_inplace_<suffix>() functions.
+   sort_count is how many keys, out of count, have to be sorted once the
+   NaNs, if any, have been moved to the end. */
+#define RADIX_DEFINE_SORT_INPLACE(suffix, type, sort_count) \
+void Radix_sort_inplace_##suffix(type array[], size_t count){ \
+    count = sort_count; \
+    if (count < 2){ \
+        return; \
+    } \
+    Radix_msd_##suffix(array, count, sizeof(type)-1); \
+}
+
+RADIX_DEFINE_SORT_INPLACE(u32, uint32_t, count)
+RADIX_DEFINE_SORT_INPLACE(i32, int32_t, count)
+RADIX_DEFINE_SORT_INPLACE(f32, float, Move_nans_last_f32(array, count))
+RADIX_DEFINE_SORT_INPLACE(u64, uint64_t, count)
+RADIX_DEFINE_SORT_INPLACE(i64, int64_t, count)
+RADIX_DEFINE_SORT_INPLACE(f64, double, Move_nans_last_f64(array, count))
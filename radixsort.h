@@ -0,0 +1,49 @@
+#ifndef RADIXSORT_H
+#define RADIXSORT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Radix sorts for fixed-width integer and floating-point keys.
+ *
+ * Rather than comparing keys, these distribute them by their bytes, so they
+ * run in O(n * width of the key) time instead of O(n log n).
+ *
+ * Signed integers and floats are ordered the way their types compare.
+ * For floats, -0.0 sorts before +0.0, and NaNs are all placed at the end,
+ * after +inf, in the order they came in.
+ */
+
+// LSD radix sort. Stable. Needs a scratch buffer as large as the array; if that
+// can't be allocated, the array is sorted by Radix_sort_inplace_<suffix>()
+// instead, so not stably.
+void Radix_sort_u32(uint32_t array[], size_t count);
+void Radix_sort_i32(int32_t array[], size_t count);
+void Radix_sort_f32(float array[], size_t count);
+void Radix_sort_u64(uint64_t array[], size_t count);
+void Radix_sort_i64(int64_t array[], size_t count);
+void Radix_sort_f64(double array[], size_t count);
+
+// Parallel LSD radix sort, on threads threads (0 for one per online CPU).
+// Stable; same results and memory needs as Radix_sort_<suffix>(), which it
+// falls back to for short arrays or if the threads can't be set up.
+void Radix_sort_parallel_u32(uint32_t array[], size_t count, unsigned int threads);
+void Radix_sort_parallel_i32(int32_t array[], size_t count, unsigned int threads);
+void Radix_sort_parallel_f32(float array[], size_t count, unsigned int threads);
+void Radix_sort_parallel_u64(uint64_t array[], size_t count, unsigned int threads);
+void Radix_sort_parallel_i64(int64_t array[], size_t count, unsigned int threads);
+void Radix_sort_parallel_f64(double array[], size_t count, unsigned int threads);
+
+// In-place MSD radix sort (American flag sort). Not stable. No scratch buffer:
+// like heapsort, it only needs a bounded amount of stack on top of the array.
+// Small buckets are sorted by Sort_quicksort_<suffix>(), so for floats, the
+// relative order of -0.0 and +0.0 is unspecified here.
+void Radix_sort_inplace_u32(uint32_t array[], size_t count);
+void Radix_sort_inplace_i32(int32_t array[], size_t count);
+void Radix_sort_inplace_f32(float array[], size_t count);
+void Radix_sort_inplace_u64(uint64_t array[], size_t count);
+void Radix_sort_inplace_i64(int64_t array[], size_t count);
+void Radix_sort_inplace_f64(double array[], size_t count);
+
+
+#endif
@@ -0,0 +1,318 @@
+#include "smoothsort.h"
+#include <stdbool.h>
+
+
+/* ************************************************ */
+/* --------------- IMPLEMENTATION NOTES ------------*/
+/*                      * * *
+    Smoothsort works like heapsort (see heapsort.c), with a different kind
+    of heap: rather than one binary tree with its root at the start of the
+    array, the array is covered, from left to right, by a forest of
+    Leonardo trees, each a max heap with its root at its right end.
+
+    The Leonardo numbers are L(0) = L(1) = 1, L(k) = L(k-1) + L(k-2) + 1.
+    A Leonardo tree of order k has L(k) nodes: for k >= 2, its root, right
+    before which come its left subtree, a Leonardo tree of order k-1, and then
+    its right subtree, of order k-2. So with the root at index r, the
+    roots of the subtrees are at r-1 (right) and r-1-L(k-2) (left).
+
+    Any number of elements can be covered by Leonardo trees of strictly
+    decreasing orders, except maybe for the last two, which can be of orders
+    1 and 0. The forest is described by the list of the orders of its
+    trees, from left to right; only the orders are stored, as the position
+    of every root follows from them.
+
+    On top of every tree being a heap, the roots of the trees are kept in
+    ascending order from left to right, so the root of the last tree is
+    the largest element of the whole forest.
+
+                * * *
+    a) Building the forest: the elements are added one at a time, from left
+    to right. If the last two trees are of consecutive orders k+1 and k, the
+    new element becomes the root of a tree of order k+2 with them as subtrees.
+    Otherwise, it becomes a new tree of order 1 (or 0 if the last tree is
+    of order 1).
+
+    If the new tree is going to be merged into a larger one later on, as a
+    subtree, its root only needs to be sifted down within it (Smooth_sift()),
+    and the ascending order of the roots can wait until the larger tree's
+    root is added. Otherwise, the new root is moved to its place by
+    Smooth_trinkle(): while the previous tree's root is larger than it -- and
+    larger than both its children, so that the tree it moves into stays a
+    heap -- the two roots are swapped, and the same is done with the tree
+    before, and so on. Finally, the value is sifted down within the tree it
+    ended up at the root of, as in heapsort.
+
+    b) Dismantling it: the root of the last tree, being the largest element,
+    is already in its final place. Removing it leaves the forest without its
+    last element: if it was a tree of order 0 or 1, that's all; otherwise, its
+    two subtrees are exposed as trees of their own, and each of their roots
+    trinkled in turn to restore the ascending order of the roots.
+
+                * * *
+    On sorted input, every trinkle stops at the first comparison and every
+    sift right away, since each root is already greater than the previous
+    root and than its children: the sort takes linear time. On random input,
+    it's O(n log n), like heapsort, with a larger constant.
+
+    The only memory used, besides a few variables, is the list of orders and
+    a table of the Leonardo numbers, both on the stack and of a fixed
+    size: a size_t can't count more elements than L(91), and there are
+    never more trees than orders, plus one.
+
+    As in heapsort.c, the byte version keeps the value being sifted aside and
+    moves the others into its hole, while the generic version swaps elements.
+*  -------------------------------------------------------------- */
+/* ************************************************************** */
+
+
+// number of Leonardo numbers that fit in a 64-bit size_t, and bound on the
+// number of trees in the forest
+#define SMOOTH_MAX_ORDERS 96
+
+
+
+
+
+
+/* ********************************************************************************* */
+/* ---------------------------- PRIVATE FUNCTIONS ---------------------------------- */
+
+static void Smooth_leonardo_table(size_t leonardo[SMOOTH_MAX_ORDERS], size_t count){
+    /* Fill leonardo[] with the Leonardo numbers, as far as needed for a
+       forest of count elements */
+    leonardo[0] = 1;
+    leonardo[1] = 1;
+    for (unsigned int order = 2; order < SMOOTH_MAX_ORDERS && leonardo[order-1] <= count; order++){
+        leonardo[order] = leonardo[order-1] + leonardo[order-2] + 1;
+    }
+}
+
+
+
+static inline bool Smooth_will_merge(const unsigned char orders[], size_t trees, size_t last,
+                                     size_t count, const size_t leonardo[]){
+    /* Whether the last tree, whose root is at index last, is going to become
+       a subtree of a larger tree before the forest is complete: either
+       right away, with the previous tree, if that one is of the next order
+       up, or once a tree of the next order down has been built after it */
+    unsigned int order = orders[trees-1];
+
+    if (trees >= 2 && orders[trees-2] == order+1){
+        return last+1 < count;
+    }
+    return order >= 1 && leonardo[order-1] < count - last - 1;
+}
+
+
+
+static void Smooth_sift(char the_array[], size_t root, unsigned int order, const size_t leonardo[]){
+    /* Sift the root of a tree of the given order down the tree */
+    char value = the_array[root];
+
+    while (order >= 2){
+        size_t right = root-1;
+        size_t left = right - leonardo[order-2];
+        size_t child = right;
+        unsigned int child_order = order-2;
+
+        if (the_array[left] > the_array[right]){
+            child = left;
+            child_order = order-1;
+        }
+        if (the_array[child] <= value){
+            break;
+        }
+        the_array[root] = the_array[child];
+        root = child;
+        order = child_order;
+    }
+    the_array[root] = value;
+}
+
+
+
+static void Smooth_trinkle(char the_array[], size_t root, const unsigned char orders[], size_t tree,
+                           const size_t leonardo[]){
+    /* Move the root of the tree'th tree, at index root, left along the roots
+       of the trees to its place, then sift it down the tree it ends up in */
+    char value = the_array[root];
+
+    while (tree > 0){
+        unsigned int order = orders[tree];
+        size_t previous = root - leonardo[order];
+        char previous_value = the_array[previous];
+
+        if (previous_value <= value){
+            break;
+        }
+        if (order >= 2){
+            size_t right = root-1;
+            size_t left = right - leonardo[order-2];
+            if (previous_value <= the_array[left] || previous_value <= the_array[right]){
+                break;
+            }
+        }
+        the_array[root] = previous_value;
+        root = previous;
+        tree--;
+    }
+    the_array[root] = value;
+    Smooth_sift(the_array, root, orders[tree], leonardo);
+}
+
+
+
+static void Smooth_sift_generic(char *base, size_t root, unsigned int order, const size_t leonardo[],
+                                size_t size, Sort_compare_fn compare){
+    /* Element-size-agnostic version of Smooth_sift() */
+    while (order >= 2){
+        size_t right = root-1;
+        size_t left = right - leonardo[order-2];
+        size_t child = right;
+        unsigned int child_order = order-2;
+
+        if (compare(base + left*size, base + right*size) > 0){
+            child = left;
+            child_order = order-1;
+        }
+        if (compare(base + child*size, base + root*size) <= 0){
+            break;
+        }
+        Sort_swap_elements(base + child*size, base + root*size, size);
+        root = child;
+        order = child_order;
+    }
+}
+
+
+
+static void Smooth_trinkle_generic(char *base, size_t root, const unsigned char orders[], size_t tree,
+                                   const size_t leonardo[], size_t size, Sort_compare_fn compare){
+    /* Element-size-agnostic version of Smooth_trinkle() */
+    while (tree > 0){
+        unsigned int order = orders[tree];
+        size_t previous = root - leonardo[order];
+
+        if (compare(base + previous*size, base + root*size) <= 0){
+            break;
+        }
+        if (order >= 2){
+            size_t right = root-1;
+            size_t left = right - leonardo[order-2];
+            if (compare(base + previous*size, base + left*size) <= 0 ||
+                compare(base + previous*size, base + right*size) <= 0){
+                break;
+            }
+        }
+        Sort_swap_elements(base + previous*size, base + root*size, size);
+        root = previous;
+        tree--;
+    }
+    Smooth_sift_generic(base, root, orders[tree], leonardo, size, compare);
+}
+
+/* ------------------------------- END PRIVATE ------------------------------------- */
+/* ********************************************************************************* */
+
+
+
+
+void Smooth_sort(char the_array[], size_t size){
+    size_t leonardo[SMOOTH_MAX_ORDERS];
+    unsigned char orders[SMOOTH_MAX_ORDERS];
+    size_t trees = 0;
+
+    if (size < 2){
+        return;
+    }
+    Smooth_leonardo_table(leonardo, size);
+
+    // a) build the forest
+    for (size_t i = 0; i < size; i++){
+        if (trees >= 2 && orders[trees-2] == orders[trees-1]+1){
+            trees--;
+            orders[trees-1]++;
+        }
+        else if (trees >= 1 && orders[trees-1] == 1){
+            orders[trees++] = 0;
+        }
+        else{
+            orders[trees++] = 1;
+        }
+        if (Smooth_will_merge(orders, trees, i, size, leonardo)){
+            Smooth_sift(the_array, i, orders[trees-1], leonardo);
+        }
+        else{
+            Smooth_trinkle(the_array, i, orders, trees-1, leonardo);
+        }
+    }
+
+    // b) dismantle it, largest root first
+    for (size_t i = size-1; i > 0; i--){
+        unsigned int order = orders[trees-1];
+
+        if (order < 2){
+            trees--;
+            continue;
+        }
+        size_t right = i-1;
+        size_t left = right - leonardo[order-2];
+
+        orders[trees-1] = order-1;
+        orders[trees++] = order-2;
+        Smooth_trinkle(the_array, left, orders, trees-2, leonardo);
+        Smooth_trinkle(the_array, right, orders, trees-1, leonardo);
+    }
+}
+
+
+
+void Smooth_sort_generic(void *base, size_t count, size_t size, Sort_compare_fn compare){
+    /* Type-generic version of Smooth_sort(): sort count elements of size bytes
+       each, ordered by compare. */
+    char *the_array = base;
+    size_t leonardo[SMOOTH_MAX_ORDERS];
+    unsigned char orders[SMOOTH_MAX_ORDERS];
+    size_t trees = 0;
+
+    if (count < 2){
+        return;
+    }
+    Smooth_leonardo_table(leonardo, count);
+
+    for (size_t i = 0; i < count; i++){
+        if (trees >= 2 && orders[trees-2] == orders[trees-1]+1){
+            trees--;
+            orders[trees-1]++;
+        }
+        else if (trees >= 1 && orders[trees-1] == 1){
+            orders[trees++] = 0;
+        }
+        else{
+            orders[trees++] = 1;
+        }
+        if (Smooth_will_merge(orders, trees, i, count, leonardo)){
+            Smooth_sift_generic(the_array, i, orders[trees-1], leonardo, size, compare);
+        }
+        else{
+            Smooth_trinkle_generic(the_array, i, orders, trees-1, leonardo, size, compare);
+        }
+    }
+
+    for (size_t i = count-1; i > 0; i--){
+        unsigned int order = orders[trees-1];
+
+        if (order < 2){
+            trees--;
+            continue;
+        }
+        size_t right = i-1;
+        size_t left = right - leonardo[order-2];
+
+        orders[trees-1] = order-1;
+        orders[trees++] = order-2;
+        Smooth_trinkle_generic(the_array, left, orders, trees-2, leonardo, size, compare);
+        Smooth_trinkle_generic(the_array, right, orders, trees-1, leonardo, size, compare);
+    }
+}
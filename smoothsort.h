@@ -0,0 +1,21 @@
+#ifndef SMOOTHSORT_H
+#define SMOOTHSORT_H
+
+#include <stddef.h>
+#include "sort_common.h"
+
+/* Smoothsort: an adaptive variant of heapsort (Dijkstra, 1981).
+ *
+ * In place, O(1) memory and O(n log n) time in the worst case, as Heap_sort(),
+ * but O(n) on input that's already sorted, and close to that on input that
+ * nearly is. Not stable.
+ */
+
+// size is the number of elements in the_array
+void Smooth_sort(char the_array[], size_t size);
+
+// sort count elements of size bytes each, starting at base, ordered by compare
+void Smooth_sort_generic(void *base, size_t count, size_t size, Sort_compare_fn compare);
+
+
+#endif
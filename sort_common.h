@@ -0,0 +1,54 @@
+#ifndef SORT_COMMON_H
+#define SORT_COMMON_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+/* Declarations shared by the type-generic sorting and heap routines
+ * (sorting.c, heapsort.c).
+ *
+ * The generic routines mirror qsort(): they take a base pointer, the
+ * number of elements, the size of each element in bytes and a comparator.
+ */
+
+
+/* Comparator used by all the *_generic routines.
+ * Returns < 0 if *a sorts before *b, 0 if they're equivalent and
+ * > 0 if *a sorts after *b -- same contract as the qsort() comparator.
+ */
+typedef int (*Sort_compare_fn)(const void *a, const void *b);
+
+
+
+static inline void Sort_swap_elements(void *element1, void *element2, size_t size){
+    /* Swap two elements of size bytes each.
+
+       The bulk of the element is swapped one machine word (uint64_t) at a time,
+       and only the tail (size % 8 bytes) is swapped byte by byte. memcpy() is used
+       for the word-sized loads and stores so that elements don't need to be
+       suitably aligned; compilers turn these into plain register moves.
+    */
+    unsigned char *a = element1;
+    unsigned char *b = element2;
+    uint64_t word1, word2;
+
+    for (; size >= sizeof(uint64_t); size -= sizeof(uint64_t)){
+        memcpy(&word1, a, sizeof(uint64_t));
+        memcpy(&word2, b, sizeof(uint64_t));
+        memcpy(a, &word2, sizeof(uint64_t));
+        memcpy(b, &word1, sizeof(uint64_t));
+        a += sizeof(uint64_t);
+        b += sizeof(uint64_t);
+    }
+
+    unsigned char temp;
+    for (; size > 0; size--){
+        temp = *a;
+        *a++ = *b;
+        *b++ = temp;
+    }
+}
+
+
+#endif
@@ -0,0 +1,465 @@
+#include "sort_simd.h"
+#include "sort_typed.h"
+#include <string.h>
+#include <pthread.h>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define SORT_SIMD_X86 1
+#include <immintrin.h>
+#endif
+
+
+/* ************************************************ */
+/* --------------- IMPLEMENTATION NOTES ------------*/
+/*                      * * *
+    The quicksort driver (Quicksort_simd_<suffix>()) is the same as the
+    one of the typed kernels: median of three pivot, recursion on the smaller
+    side only, heapsort once the recursion gets too deep (as in
+    Sort_introsort_array()), and the scalar block quicksort for ranges of
+    SIMD_SMALL_SORT_THRESHOLD keys or fewer.
+    Only the partition step is vectorized.
+
+    The partition is done in place:
+    the first and last vector's worth of keys are copied aside, which leaves
+    room for one vector's worth of output at either end of the range. Then,
+    one vector at a time, keys are loaded from whichever end has the least
+    room left, compared against the pivot, and the keys that go left are
+    written at the left end while the keys that go right are written at the
+    right end. Loading from the end with less room guarantees there's always
+    at least a whole vector's worth of room at both ends, so the AVX2
+    version can store full vectors, garbage lanes included, without
+    overwriting keys that haven't been read yet.
+    Last, the keys set aside and the few left over (less than a vector's
+    worth) are placed in the remaining room, one at a time.
+
+    Keys equal to the pivot all go right. If that leaves the left side
+    empty, the pivot is the smallest key in the range, and the range is
+    partitioned again with the keys <= pivot going left -- those are all
+    equal to the pivot, and are done with.
+*  -------------------------------------------------------------- */
+/* ************************************************************** */
+
+
+// ranges this short are left to the scalar block quicksort
+#define SIMD_SMALL_SORT_THRESHOLD 256
+
+static Sort_simd_level Detected_level = SORT_SIMD_SCALAR;
+static Sort_simd_level Current_level = SORT_SIMD_SCALAR;
+static pthread_once_t Init_once = PTHREAD_ONCE_INIT;
+
+// partition functions for the current level; NULL means use the scalar kernel
+static size_t (*Partition_i32)(int32_t [], size_t, int32_t, int);
+static size_t (*Partition_i64)(int64_t [], size_t, int64_t, int);
+static size_t (*Partition_f32)(float [], size_t, float, int);
+static size_t (*Partition_f64)(double [], size_t, double, int);
+
+
+
+
+/* ********************************************************************************* */
+/* ---------------------------- PRIVATE FUNCTIONS ---------------------------------- */
+
+#ifdef SORT_SIMD_X86
+
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#define TARGET_AVX512 __attribute__((target("avx512f")))
+
+/* For each AVX2 comparison mask, the permutation that moves the lanes set
+   in the mask to the front of the vector, in order, followed by the others.
+   Filled in by Sort_simd_init(). */
+static int32_t Permute_32[256][8];   // 8 lanes of 32 bits
+static int32_t Permute_64[16][8];    // 4 lanes of 64 bits, as pairs of 32-bit lanes
+
+
+static void Permute_tables_init(void){
+    for (unsigned int mask = 0; mask < 256; mask++){
+        int n = 0;
+        for (int lane = 0; lane < 8; lane++){
+            if (mask & (1u<<lane)){
+                Permute_32[mask][n++] = lane;
+            }
+        }
+        for (int lane = 0; lane < 8; lane++){
+            if (!(mask & (1u<<lane))){
+                Permute_32[mask][n++] = lane;
+            }
+        }
+    }
+    for (unsigned int mask = 0; mask < 16; mask++){
+        int n = 0;
+        for (int lane = 0; lane < 4; lane++){
+            if (mask & (1u<<lane)){
+                Permute_64[mask][n++] = 2*lane;
+                Permute_64[mask][n++] = 2*lane+1;
+            }
+        }
+        for (int lane = 0; lane < 4; lane++){
+            if (!(mask & (1u<<lane))){
+                Permute_64[mask][n++] = 2*lane;
+                Permute_64[mask][n++] = 2*lane+1;
+            }
+        }
+    }
+}
+
+
+
+/* ---------------- Per-type vector operations ----------------
+   <isa>_partition_vector_<suffix>() compares the keys in v against the pivot
+   and writes those that go left at array[*write_left] and those that go right
+   just below array[*write_right], advancing both write positions.
+   inclusive selects between key < pivot (0) and key <= pivot (1) going left.
+*/
+
+TARGET_AVX2 static inline void Avx2_partition_vector_i32(__m256i v, __m256i pivot, int inclusive,
+                                                         int32_t array[], size_t *write_left, size_t *write_right){
+    __m256i left = inclusive ? _mm256_xor_si256(_mm256_cmpgt_epi32(v, pivot), _mm256_set1_epi32(-1))
+                             : _mm256_cmpgt_epi32(pivot, v);
+    unsigned int mask = (unsigned int)_mm256_movemask_ps(_mm256_castsi256_ps(left));
+    __m256i packed = _mm256_permutevar8x32_epi32(v, _mm256_loadu_si256((const __m256i *)Permute_32[mask]));
+    unsigned int left_count = (unsigned int)__builtin_popcount(mask);
+
+    _mm256_storeu_si256((__m256i *)(array + *write_left), packed);
+    _mm256_storeu_si256((__m256i *)(array + *write_right - 8), packed);
+    *write_left += left_count;
+    *write_right -= 8 - left_count;
+}
+
+TARGET_AVX2 static inline void Avx2_partition_vector_f32(__m256 v, __m256 pivot, int inclusive,
+                                                         float array[], size_t *write_left, size_t *write_right){
+    __m256 left = inclusive ? _mm256_cmp_ps(v, pivot, _CMP_LE_OQ) : _mm256_cmp_ps(v, pivot, _CMP_LT_OQ);
+    unsigned int mask = (unsigned int)_mm256_movemask_ps(left);
+    __m256 packed = _mm256_permutevar8x32_ps(v, _mm256_loadu_si256((const __m256i *)Permute_32[mask]));
+    unsigned int left_count = (unsigned int)__builtin_popcount(mask);
+
+    _mm256_storeu_ps(array + *write_left, packed);
+    _mm256_storeu_ps(array + *write_right - 8, packed);
+    *write_left += left_count;
+    *write_right -= 8 - left_count;
+}
+
+TARGET_AVX2 static inline void Avx2_partition_vector_i64(__m256i v, __m256i pivot, int inclusive,
+                                                         int64_t array[], size_t *write_left, size_t *write_right){
+    __m256i left = inclusive ? _mm256_xor_si256(_mm256_cmpgt_epi64(v, pivot), _mm256_set1_epi64x(-1))
+                             : _mm256_cmpgt_epi64(pivot, v);
+    unsigned int mask = (unsigned int)_mm256_movemask_pd(_mm256_castsi256_pd(left));
+    __m256i packed = _mm256_permutevar8x32_epi32(v, _mm256_loadu_si256((const __m256i *)Permute_64[mask]));
+    unsigned int left_count = (unsigned int)__builtin_popcount(mask);
+
+    _mm256_storeu_si256((__m256i *)(array + *write_left), packed);
+    _mm256_storeu_si256((__m256i *)(array + *write_right - 4), packed);
+    *write_left += left_count;
+    *write_right -= 4 - left_count;
+}
+
+TARGET_AVX2 static inline void Avx2_partition_vector_f64(__m256d v, __m256d pivot, int inclusive,
+                                                         double array[], size_t *write_left, size_t *write_right){
+    __m256d left = inclusive ? _mm256_cmp_pd(v, pivot, _CMP_LE_OQ) : _mm256_cmp_pd(v, pivot, _CMP_LT_OQ);
+    unsigned int mask = (unsigned int)_mm256_movemask_pd(left);
+    __m256d packed = _mm256_castps_pd(_mm256_permutevar8x32_ps(_mm256_castpd_ps(v),
+                                      _mm256_loadu_si256((const __m256i *)Permute_64[mask])));
+    unsigned int left_count = (unsigned int)__builtin_popcount(mask);
+
+    _mm256_storeu_pd(array + *write_left, packed);
+    _mm256_storeu_pd(array + *write_right - 4, packed);
+    *write_left += left_count;
+    *write_right -= 4 - left_count;
+}
+
+
+TARGET_AVX512 static inline void Avx512_partition_vector_i32(__m512i v, __m512i pivot, int inclusive,
+                                                             int32_t array[], size_t *write_left, size_t *write_right){
+    __mmask16 mask = inclusive ? _mm512_cmple_epi32_mask(v, pivot) : _mm512_cmplt_epi32_mask(v, pivot);
+    unsigned int left_count = (unsigned int)__builtin_popcount(mask);
+
+    _mm512_mask_compressstoreu_epi32(array + *write_left, mask, v);
+    *write_left += left_count;
+    *write_right -= 16 - left_count;
+    _mm512_mask_compressstoreu_epi32(array + *write_right, (__mmask16)~mask, v);
+}
+
+TARGET_AVX512 static inline void Avx512_partition_vector_f32(__m512 v, __m512 pivot, int inclusive,
+                                                             float array[], size_t *write_left, size_t *write_right){
+    __mmask16 mask = inclusive ? _mm512_cmp_ps_mask(v, pivot, _CMP_LE_OQ) : _mm512_cmp_ps_mask(v, pivot, _CMP_LT_OQ);
+    unsigned int left_count = (unsigned int)__builtin_popcount(mask);
+
+    _mm512_mask_compressstoreu_ps(array + *write_left, mask, v);
+    *write_left += left_count;
+    *write_right -= 16 - left_count;
+    _mm512_mask_compressstoreu_ps(array + *write_right, (__mmask16)~mask, v);
+}
+
+TARGET_AVX512 static inline void Avx512_partition_vector_i64(__m512i v, __m512i pivot, int inclusive,
+                                                             int64_t array[], size_t *write_left, size_t *write_right){
+    __mmask8 mask = inclusive ? _mm512_cmple_epi64_mask(v, pivot) : _mm512_cmplt_epi64_mask(v, pivot);
+    unsigned int left_count = (unsigned int)__builtin_popcount(mask);
+
+    _mm512_mask_compressstoreu_epi64(array + *write_left, mask, v);
+    *write_left += left_count;
+    *write_right -= 8 - left_count;
+    _mm512_mask_compressstoreu_epi64(array + *write_right, (__mmask8)~mask, v);
+}
+
+TARGET_AVX512 static inline void Avx512_partition_vector_f64(__m512d v, __m512d pivot, int inclusive,
+                                                             double array[], size_t *write_left, size_t *write_right){
+    __mmask8 mask = inclusive ? _mm512_cmp_pd_mask(v, pivot, _CMP_LE_OQ) : _mm512_cmp_pd_mask(v, pivot, _CMP_LT_OQ);
+    unsigned int left_count = (unsigned int)__builtin_popcount(mask);
+
+    _mm512_mask_compressstoreu_pd(array + *write_left, mask, v);
+    *write_left += left_count;
+    *write_right -= 8 - left_count;
+    _mm512_mask_compressstoreu_pd(array + *write_right, (__mmask8)~mask, v);
+}
+
+
+
+/* Generates Partition_<isa>_<suffix>(array, count, pivot, inclusive), the
+   in-place vector partition described in the notes at the top. Returns the
+   number of keys that went left. count must be at least 2*lanes. */
+#define SIMD_DEFINE_PARTITION(isa, target, suffix, type, lanes, vector_type, load, set1) \
+target static size_t Partition_##isa##_##suffix(type array[], size_t count, type pivot, int inclusive){ \
+    type set_aside[3*(lanes)]; \
+    size_t set_aside_count = 2*(lanes); \
+    vector_type pivot_vector = set1(pivot); \
+    \
+    memcpy(set_aside, array, (lanes)*sizeof(type)); \
+    memcpy(set_aside + (lanes), array + count - (lanes), (lanes)*sizeof(type)); \
+    \
+    size_t read_left = (lanes), read_right = count - (lanes); \
+    size_t write_left = 0, write_right = count; \
+    \
+    while (read_right - read_left >= (lanes)){ \
+        vector_type v; \
+        if (read_left - write_left <= write_right - read_right){ \
+            v = load(array + read_left); \
+            read_left += (lanes); \
+        } \
+        else{ \
+            read_right -= (lanes); \
+            v = load(array + read_right); \
+        } \
+        isa##_partition_vector_##suffix(v, pivot_vector, inclusive, array, &write_left, &write_right); \
+    } \
+    \
+    memcpy(set_aside + set_aside_count, array + read_left, (read_right - read_left)*sizeof(type)); \
+    set_aside_count += read_right - read_left; \
+    \
+    for (size_t i = 0; i < set_aside_count; i++){ \
+        type key = set_aside[i]; \
+        if (inclusive ? !(pivot < key) : key < pivot){ \
+            array[write_left++] = key; \
+        } \
+        else{ \
+            array[--write_right] = key; \
+        } \
+    } \
+    return write_left; \
+}
+
+
+TARGET_AVX2 static inline __m256i Avx2_load_i(const void *p){ return _mm256_loadu_si256((const __m256i *)p); }
+TARGET_AVX512 static inline __m512i Avx512_load_i(const void *p){ return _mm512_loadu_si512(p); }
+
+SIMD_DEFINE_PARTITION(Avx2, TARGET_AVX2, i32, int32_t, 8, __m256i, Avx2_load_i, _mm256_set1_epi32)
+SIMD_DEFINE_PARTITION(Avx2, TARGET_AVX2, i64, int64_t, 4, __m256i, Avx2_load_i, _mm256_set1_epi64x)
+SIMD_DEFINE_PARTITION(Avx2, TARGET_AVX2, f32, float, 8, __m256, _mm256_loadu_ps, _mm256_set1_ps)
+SIMD_DEFINE_PARTITION(Avx2, TARGET_AVX2, f64, double, 4, __m256d, _mm256_loadu_pd, _mm256_set1_pd)
+
+SIMD_DEFINE_PARTITION(Avx512, TARGET_AVX512, i32, int32_t, 16, __m512i, Avx512_load_i, _mm512_set1_epi32)
+SIMD_DEFINE_PARTITION(Avx512, TARGET_AVX512, i64, int64_t, 8, __m512i, Avx512_load_i, _mm512_set1_epi64)
+SIMD_DEFINE_PARTITION(Avx512, TARGET_AVX512, f32, float, 16, __m512, _mm512_loadu_ps, _mm512_set1_ps)
+SIMD_DEFINE_PARTITION(Avx512, TARGET_AVX512, f64, double, 8, __m512d, _mm512_loadu_pd, _mm512_set1_pd)
+
+#endif  // SORT_SIMD_X86
+
+
+
+static void Select_partitions(void){
+    /* Point the partition function pointers at the kernels for Current_level */
+    Partition_i32 = NULL;
+    Partition_i64 = NULL;
+    Partition_f32 = NULL;
+    Partition_f64 = NULL;
+
+#ifdef SORT_SIMD_X86
+    if (Current_level == SORT_SIMD_AVX512){
+        Partition_i32 = Partition_Avx512_i32;
+        Partition_i64 = Partition_Avx512_i64;
+        Partition_f32 = Partition_Avx512_f32;
+        Partition_f64 = Partition_Avx512_f64;
+    }
+    else if (Current_level == SORT_SIMD_AVX2){
+        Partition_i32 = Partition_Avx2_i32;
+        Partition_i64 = Partition_Avx2_i64;
+        Partition_f32 = Partition_Avx2_f32;
+        Partition_f64 = Partition_Avx2_f64;
+    }
+#endif
+}
+
+
+
+static void Sort_simd_init_once(void){
+    /* Detect the best instruction set the CPU supports, and select it */
+#ifdef SORT_SIMD_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f")){
+        Detected_level = SORT_SIMD_AVX512;
+    }
+    else if (__builtin_cpu_supports("avx2")){
+        Detected_level = SORT_SIMD_AVX2;
+    }
+    Permute_tables_init();
+#endif
+    Current_level = Detected_level;
+    Select_partitions();
+}
+
+
+static void Sort_simd_init(void){
+    pthread_once(&Init_once, Sort_simd_init_once);
+}
+
+
+
+static unsigned int Depth_limit(size_t count){
+    // 2*log2(count), as in Sort_introsort_array()
+    unsigned int depth_limit = 0;
+
+    for (; count > 1; count >>= 1){
+        depth_limit += 2;
+    }
+    return depth_limit;
+}
+
+
+
+/* Generates Quicksort_simd_<suffix>(), the quicksort driver around a
+   vector partition function */
+#define SIMD_DEFINE_QUICKSORT(suffix, type) \
+static void Quicksort_simd_##suffix(type array[], size_t count, unsigned int depth_limit, \
+                                    size_t (*partition)(type [], size_t, type, int)){ \
+    while (count > SIMD_SMALL_SORT_THRESHOLD){ \
+        if (depth_limit == 0){ \
+            Sort_heapsort_##suffix(array, count); \
+            return; \
+        } \
+        depth_limit--; \
+        \
+        type a = array[0], b = array[count>>1], c = array[count-1]; \
+        type pivot = (a < b) ? ((b < c) ? b : ((a < c) ? c : a)) \
+                             : ((a < c) ? a : ((b < c) ? c : b)); \
+        \
+        size_t left_count = partition(array, count, pivot, 0); \
+        if (left_count == 0){ \
+            /* nothing below the pivot: put aside all the keys equal to it */ \
+            left_count = partition(array, count, pivot, 1); \
+            array += left_count; \
+            count -= left_count; \
+            continue; \
+        } \
+        \
+        size_t right_count = count - left_count; \
+        if (left_count < right_count){ \
+            Quicksort_simd_##suffix(array, left_count, depth_limit, partition); \
+            array += left_count; \
+            count = right_count; \
+        } \
+        else{ \
+            Quicksort_simd_##suffix(array + left_count, right_count, depth_limit, partition); \
+            count = left_count; \
+        } \
+    } \
+    Sort_quicksort_block_##suffix(array, count); \
+}
+
+SIMD_DEFINE_QUICKSORT(i32, int32_t)
+SIMD_DEFINE_QUICKSORT(i64, int64_t)
+SIMD_DEFINE_QUICKSORT(f32, float)
+SIMD_DEFINE_QUICKSORT(f64, double)
+
+
+
+/* Generates Move_nans_last_<suffix>(), which moves the NaNs to the end of the
+   array and returns the number of other keys, which come before them */
+#define SIMD_DEFINE_MOVE_NANS(suffix, type) \
+static size_t Move_nans_last_##suffix(type array[], size_t count){ \
+    size_t numbers = 0; \
+    for (size_t i = 0; i < count; i++){ \
+        if (array[i] == array[i]){ \
+            type temp = array[numbers]; \
+            array[numbers++] = array[i]; \
+            array[i] = temp; \
+        } \
+    } \
+    return numbers; \
+}
+
+SIMD_DEFINE_MOVE_NANS(f32, float)
+SIMD_DEFINE_MOVE_NANS(f64, double)
+
+/* ------------------------------- END PRIVATE ------------------------------------- */
+/* ********************************************************************************* */
+
+
+
+
+Sort_simd_level Sort_simd_get_level(void){
+    Sort_simd_init();
+    return Current_level;
+}
+
+
+
+Sort_simd_level Sort_simd_set_level(Sort_simd_level level){
+    Sort_simd_init();
+    Current_level = (level < Detected_level) ? level : Detected_level;
+    Select_partitions();
+    return Current_level;
+}
+
+
+
+void Sort_quicksort_simd_i32(int32_t array[], size_t count){
+    Sort_simd_init();
+    if (!Partition_i32){
+        Sort_quicksort_block_i32(array, count);
+        return;
+    }
+    Quicksort_simd_i32(array, count, Depth_limit(count), Partition_i32);
+}
+
+
+
+void Sort_quicksort_simd_i64(int64_t array[], size_t count){
+    Sort_simd_init();
+    if (!Partition_i64){
+        Sort_quicksort_block_i64(array, count);
+        return;
+    }
+    Quicksort_simd_i64(array, count, Depth_limit(count), Partition_i64);
+}
+
+
+
+void Sort_quicksort_simd_f32(float array[], size_t count){
+    Sort_simd_init();
+    count = Move_nans_last_f32(array, count);
+    if (!Partition_f32){
+        Sort_quicksort_block_f32(array, count);
+        return;
+    }
+    Quicksort_simd_f32(array, count, Depth_limit(count), Partition_f32);
+}
+
+
+
+void Sort_quicksort_simd_f64(double array[], size_t count){
+    Sort_simd_init();
+    count = Move_nans_last_f64(array, count);
+    if (!Partition_f64){
+        Sort_quicksort_block_f64(array, count);
+        return;
+    }
+    Quicksort_simd_f64(array, count, Depth_limit(count), Partition_f64);
+}
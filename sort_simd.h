@@ -0,0 +1,81 @@
+#ifndef SORT_SIMD_H
+#define SORT_SIMD_H
+
+/* *********************** Overview ******************* */
+
+/* Vectorized quicksort for 32 and 64-bit numeric keys.
+ *
+ * Drop-in replacements for the Sort_quicksort_<suffix>() kernels of
+ * sort_typed.h, for the i32, i64, f32 and f64 key types. The partitioning
+ * step compares a whole vector of keys against the pivot at once and writes
+ * the keys that go to either side out in one go:
+ *      - AVX-512: 16 (32-bit) or 8 (64-bit) keys per step, written with
+ *        compress-stores;
+ *      - AVX2: 8 (32-bit) or 4 (64-bit) keys per step, packed with a
+ *        permutation looked up from the comparison mask.
+ *
+ * The instruction set is picked at run time, on first use, from what the CPU
+ * supports (CPUID), so the same binary runs on any x86-64 host. On CPUs
+ * without AVX2, and on other architectures, the scalar
+ * Sort_quicksort_block_<suffix>() kernel is used.
+ *
+ * Floats: NaNs are moved to the end of the array, after +inf. The relative
+ * order of -0.0 and +0.0 is unspecified.
+ */
+
+
+#include <stddef.h>
+#include <stdint.h>
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+typedef enum {
+    SORT_SIMD_SCALAR,
+    SORT_SIMD_AVX2,
+    SORT_SIMD_AVX512
+} Sort_simd_level;
+
+
+/* The instruction set currently used by the Sort_quicksort_simd_*() functions */
+Sort_simd_level Sort_simd_get_level(void);
+
+/* Use the given instruction set from now on, or the best one the CPU supports
+ * if that's a lower one. Returns the level actually selected.
+ * Meant for benchmarking and testing the different code paths; must not be
+ * called while a sort is running on another thread. */
+Sort_simd_level Sort_simd_set_level(Sort_simd_level level);
+
+
+void Sort_quicksort_simd_i32(int32_t array[], size_t count);
+
+void Sort_quicksort_simd_i64(int64_t array[], size_t count);
+
+void Sort_quicksort_simd_f32(float array[], size_t count);
+
+void Sort_quicksort_simd_f64(double array[], size_t count);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+
+#ifndef __cplusplus
+#define Sort_quicksort_simd_typed(array, count) _Generic((array), \
+    int32_t *:  Sort_quicksort_simd_i32, \
+    int64_t *:  Sort_quicksort_simd_i64, \
+    float *:    Sort_quicksort_simd_f32, \
+    double *:   Sort_quicksort_simd_f64)((array), (count))
+#else
+inline void Sort_quicksort_simd_typed(int32_t array[], size_t count){ Sort_quicksort_simd_i32(array, count); }
+inline void Sort_quicksort_simd_typed(int64_t array[], size_t count){ Sort_quicksort_simd_i64(array, count); }
+inline void Sort_quicksort_simd_typed(float array[], size_t count){ Sort_quicksort_simd_f32(array, count); }
+inline void Sort_quicksort_simd_typed(double array[], size_t count){ Sort_quicksort_simd_f64(array, count); }
+#endif
+
+
+#endif
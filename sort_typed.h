@@ -0,0 +1,131 @@
+#ifndef SORT_TYPED_H
+#define SORT_TYPED_H
+
+/* *********************** Overview ******************* */
+
+/* Type-specialized sort kernels.
+ *
+ * The generic routines (Sort_*_generic, Heap_sort_generic) call the
+ * comparator through a function pointer for every single comparison, which
+ * the compiler can't inline. For the common fixed-width key types, the
+ * kernels below are generated at compile time from sort_typed_template.h
+ * instead, with the comparison inlined as a plain '<'.
+ *
+ * For each type, with suffix one of
+ *      i8 i16 i32 i64 u8 u16 u32 u64 f32 f64
+ * the following are defined (all sort in place, in ascending order):
+ *      void Sort_insertion_<suffix>(type array[], size_t count);
+ *      void Sort_heapsort_<suffix>(type array[], size_t count);
+ *      void Sort_quicksort_<suffix>(type array[], size_t count);
+ *      void Sort_quicksort_block_<suffix>(type array[], size_t count);
+ * where the _block quicksort uses the branchless block partition of
+ * Partition_block_P() (sorting.c) instead of the Hoare one.
+ *
+ * The Sort_*_typed() front-ends pick the right kernel from the type of the
+ * array argument at compile time: a C11 _Generic selection in C, a set of
+ * overloads in C++. E.g.
+ *      double samples[N];
+ *      Sort_quicksort_typed(samples, N);    // calls Sort_quicksort_f64()
+ *
+ * Note that plain char is a distinct type from int8_t (signed char) and
+ * uint8_t, and isn't matched; use the char array routines in sorting.h for it.
+ * For f32 and f64, the relative order of NaNs and other values is unspecified.
+ */
+
+
+#include <stddef.h>
+#include <stdint.h>
+
+
+// number of items the block partition classifies at a time on either side
+#define SORT_TYPED_BLOCK_SIZE 64
+
+
+#define SORT_TYPE int8_t
+#define SORT_SUFFIX i8
+#include "sort_typed_template.h"
+
+#define SORT_TYPE int16_t
+#define SORT_SUFFIX i16
+#include "sort_typed_template.h"
+
+#define SORT_TYPE int32_t
+#define SORT_SUFFIX i32
+#include "sort_typed_template.h"
+
+#define SORT_TYPE int64_t
+#define SORT_SUFFIX i64
+#include "sort_typed_template.h"
+
+#define SORT_TYPE uint8_t
+#define SORT_SUFFIX u8
+#include "sort_typed_template.h"
+
+#define SORT_TYPE uint16_t
+#define SORT_SUFFIX u16
+#include "sort_typed_template.h"
+
+#define SORT_TYPE uint32_t
+#define SORT_SUFFIX u32
+#include "sort_typed_template.h"
+
+#define SORT_TYPE uint64_t
+#define SORT_SUFFIX u64
+#include "sort_typed_template.h"
+
+#define SORT_TYPE float
+#define SORT_SUFFIX f32
+#include "sort_typed_template.h"
+
+#define SORT_TYPE double
+#define SORT_SUFFIX f64
+#include "sort_typed_template.h"
+
+
+
+/* ---------------------- Compile-time front-ends ------------------------- */
+
+#ifdef __cplusplus
+
+#define SORT_TYPED_OVERLOADS(type, suffix) \
+    inline void Sort_insertion_typed(type array[], size_t count){ Sort_insertion_##suffix(array, count); } \
+    inline void Sort_heapsort_typed(type array[], size_t count){ Sort_heapsort_##suffix(array, count); } \
+    inline void Sort_quicksort_typed(type array[], size_t count){ Sort_quicksort_##suffix(array, count); } \
+    inline void Sort_quicksort_block_typed(type array[], size_t count){ Sort_quicksort_block_##suffix(array, count); }
+
+SORT_TYPED_OVERLOADS(int8_t, i8)
+SORT_TYPED_OVERLOADS(int16_t, i16)
+SORT_TYPED_OVERLOADS(int32_t, i32)
+SORT_TYPED_OVERLOADS(int64_t, i64)
+SORT_TYPED_OVERLOADS(uint8_t, u8)
+SORT_TYPED_OVERLOADS(uint16_t, u16)
+SORT_TYPED_OVERLOADS(uint32_t, u32)
+SORT_TYPED_OVERLOADS(uint64_t, u64)
+SORT_TYPED_OVERLOADS(float, f32)
+SORT_TYPED_OVERLOADS(double, f64)
+
+#undef SORT_TYPED_OVERLOADS
+
+#else
+
+#define SORT_TYPED_SELECT(algorithm, array) _Generic((array), \
+    int8_t *:   algorithm##_i8,  \
+    int16_t *:  algorithm##_i16, \
+    int32_t *:  algorithm##_i32, \
+    int64_t *:  algorithm##_i64, \
+    uint8_t *:  algorithm##_u8,  \
+    uint16_t *: algorithm##_u16, \
+    uint32_t *: algorithm##_u32, \
+    uint64_t *: algorithm##_u64, \
+    float *:    algorithm##_f32, \
+    double *:   algorithm##_f64)
+
+#define Sort_insertion_typed(array, count) SORT_TYPED_SELECT(Sort_insertion, array)((array), (count))
+#define Sort_heapsort_typed(array, count)  SORT_TYPED_SELECT(Sort_heapsort, array)((array), (count))
+#define Sort_quicksort_typed(array, count) SORT_TYPED_SELECT(Sort_quicksort, array)((array), (count))
+#define Sort_quicksort_block_typed(array, count) SORT_TYPED_SELECT(Sort_quicksort_block, array)((array), (count))
+
+#endif
+
+
+#endif
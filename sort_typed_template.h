@@ -0,0 +1,289 @@
+/* Code-generation template for the type-specialized sort kernels.
+
+   Not to be included directly: sort_typed.h includes this file once per
+   key type, after defining
+        SORT_TYPE       the element type, e.g. int32_t
+        SORT_SUFFIX     the suffix of the generated names, e.g. i32
+
+   and each inclusion produces
+        Sort_insertion_<suffix>(SORT_TYPE array[], size_t count)
+        Sort_heapsort_<suffix>(SORT_TYPE array[], size_t count)
+        Sort_quicksort_<suffix>(SORT_TYPE array[], size_t count)
+        Sort_quicksort_block_<suffix>(SORT_TYPE array[], size_t count)
+
+   The algorithms are the same as the ones of the char and generic array
+   routines (sorting.c, heapsort.c), but since the element type is known at
+   compile time, comparisons are plain '<' on registers instead of indirect
+   comparator calls, and everything can be inlined into the hot loops.
+*/
+
+#if !defined(SORT_TYPE) || !defined(SORT_SUFFIX)
+#error "define SORT_TYPE and SORT_SUFFIX before including sort_typed_template.h"
+#endif
+
+#define SORT_CAT_(a, b) a##_##b
+#define SORT_CAT(a, b) SORT_CAT_(a, b)
+#define SORT_NAME(name) SORT_CAT(name, SORT_SUFFIX)
+
+
+
+static inline void SORT_NAME(Sort_insertion)(SORT_TYPE array[], size_t count){
+    /* Straight insertion sort: the new element is held in a register while
+       the larger elements of the sorted section are shifted one to the right.
+    */
+    for (size_t current_index = 1; current_index < count; current_index++){
+        SORT_TYPE value = array[current_index];
+        size_t j = current_index;
+
+        while (j > 0 && value < array[j-1]){
+            array[j] = array[j-1];
+            j--;
+        }
+        array[j] = value;
+    }
+}
+
+
+
+static inline void SORT_NAME(Sort_sift_down)(SORT_TYPE array[], size_t current, size_t last_index){
+    /* Same as Heap_sift_down() in heapsort.c, except the sifted value is
+       kept aside and only written once, at its final position.
+    */
+    SORT_TYPE value = array[current];
+    size_t child = 1 + (current<<1);
+
+    while (child <= last_index){
+        if (child < last_index && array[child] < array[child+1]){
+            child++;
+        }
+        if (!(value < array[child])){
+            break;
+        }
+        array[current] = array[child];
+        current = child;
+        child = 1 + (current<<1);
+    }
+    array[current] = value;
+}
+
+
+
+static inline void SORT_NAME(Sort_heapsort)(SORT_TYPE array[], size_t count){
+    /* Bottom-up heap construction followed by repeated root pops,
+       as in Heap_sort().
+    */
+    if (count < 2){
+        return;
+    }
+
+    size_t last_index = count-1;
+    for (size_t non_leaf = count>>1; non_leaf-- > 0;){
+        SORT_NAME(Sort_sift_down)(array, non_leaf, last_index);
+    }
+
+    SORT_TYPE temp;
+    while (last_index){
+        temp = array[0];
+        array[0] = array[last_index];
+        array[last_index] = temp;
+        last_index--;
+        SORT_NAME(Sort_sift_down)(array, 0, last_index);
+    }
+}
+
+
+
+static inline size_t SORT_NAME(Sort_partition_hoare)(SORT_TYPE array[], size_t index_end){
+    /* Partition_hoare_n_P() from sorting.c, for the range [0, index_end].
+       The pivot is the last element. Both scans stop on elements equal to
+       it, so runs of equal keys are split evenly between the partitions.
+
+       The caller must ensure !(pivot < array[0]), which bounds the
+       right-hand scan the way the pivot bounds the left-hand one.
+    */
+    SORT_TYPE pivot_value = array[index_end];
+    size_t left = 0;
+    size_t right = index_end;
+    SORT_TYPE temp;
+
+    for (;;){
+        while (array[left] < pivot_value){
+            left++;
+        }
+        do {
+            right--;
+        } while (pivot_value < array[right]);
+
+        if (left >= right){
+            break;
+        }
+        temp = array[left];
+        array[left] = array[right];
+        array[right] = temp;
+        left++;
+    }
+
+    array[index_end] = array[left];
+    array[left] = pivot_value;
+    return left;
+}
+
+
+
+static inline void SORT_NAME(Sort_quicksort)(SORT_TYPE array[], size_t count){
+    /* Quicksort using the Hoare partition scheme of Sort_quicksort_array().
+
+       Differences from the char version, all standard:
+        - the pivot is the median of the first, middle and last elements,
+          moved to the end, so sorted and reverse-sorted inputs partition evenly;
+        - the partition scans stop on keys equal to the pivot, so all-equal
+          and few-distinct inputs partition evenly too;
+        - partitions of 16 elements or fewer are left to insertion sort;
+        - only the smaller partition is recursed on, the larger one is looped
+          on, so the recursion depth is O(log n).
+    */
+    SORT_TYPE temp;
+
+    while (count > 16){
+        size_t last = count-1;
+        size_t middle = count>>1;
+
+        // order array[0] <= array[middle] <= array[last], then put the median last,
+        // which leaves array[0] <= pivot as the partition's sentinel
+        if (array[middle] < array[0]){ temp = array[middle]; array[middle] = array[0]; array[0] = temp; }
+        if (array[last] < array[middle]){ temp = array[last]; array[last] = array[middle]; array[middle] = temp; }
+        if (array[middle] < array[0]){ temp = array[middle]; array[middle] = array[0]; array[0] = temp; }
+        temp = array[middle]; array[middle] = array[last]; array[last] = temp;
+
+        size_t pivot = SORT_NAME(Sort_partition_hoare)(array, last);
+        size_t right_count = count - pivot - 1;
+
+        if (pivot < right_count){
+            SORT_NAME(Sort_quicksort)(array, pivot);
+            array += pivot+1;
+            count = right_count;
+        }
+        else{
+            SORT_NAME(Sort_quicksort)(array + pivot+1, right_count);
+            count = pivot;
+        }
+    }
+
+    SORT_NAME(Sort_insertion)(array, count);
+}
+
+
+
+static inline size_t SORT_NAME(Sort_partition_block)(SORT_TYPE array[], size_t index_end){
+    /* Partition_block_P() from sorting.c, for the range [0, index_end].
+       The pivot is the last element.
+    */
+    SORT_TYPE pivot_value = array[index_end];
+    unsigned char offsets_left[SORT_TYPED_BLOCK_SIZE];
+    unsigned char offsets_right[SORT_TYPED_BLOCK_SIZE];
+    size_t start_left = 0, count_left = 0;
+    size_t start_right = 0, count_right = 0;
+    size_t first = 0;
+    size_t last = index_end;
+    SORT_TYPE temp;
+
+    while (last - first > 2*SORT_TYPED_BLOCK_SIZE){
+        if (count_left == 0){
+            start_left = 0;
+            for (size_t i = 0; i < SORT_TYPED_BLOCK_SIZE; i++){
+                offsets_left[count_left] = (unsigned char)i;
+                count_left += !(array[first+i] < pivot_value);
+            }
+        }
+        if (count_right == 0){
+            start_right = 0;
+            for (size_t i = 0; i < SORT_TYPED_BLOCK_SIZE; i++){
+                offsets_right[count_right] = (unsigned char)i;
+                count_right += !(pivot_value < array[last-1-i]);
+            }
+        }
+
+        size_t swaps = (count_left < count_right) ? count_left : count_right;
+        for (size_t i = 0; i < swaps; i++){
+            size_t l = first + offsets_left[start_left+i];
+            size_t r = last-1 - offsets_right[start_right+i];
+            temp = array[l];
+            array[l] = array[r];
+            array[r] = temp;
+        }
+        count_left -= swaps;
+        count_right -= swaps;
+        start_left += swaps;
+        start_right += swaps;
+
+        if (count_left == 0){
+            first += SORT_TYPED_BLOCK_SIZE;
+        }
+        if (count_right == 0){
+            last -= SORT_TYPED_BLOCK_SIZE;
+        }
+    }
+
+    for (;;){
+        while (first < last && array[first] < pivot_value){
+            first++;
+        }
+        while (first < last && pivot_value < array[last-1]){
+            last--;
+        }
+        if (last - first < 2){
+            break;
+        }
+        temp = array[first];
+        array[first] = array[last-1];
+        array[last-1] = temp;
+        first++;
+        last--;
+    }
+
+    array[index_end] = array[first];
+    array[first] = pivot_value;
+    return first;
+}
+
+
+
+static inline void SORT_NAME(Sort_quicksort_block)(SORT_TYPE array[], size_t count){
+    /* Same as Sort_quicksort_<suffix>(), partitioning with the branchless
+       block partition above instead of the Hoare one.
+    */
+    SORT_TYPE temp;
+
+    while (count > 16){
+        size_t last = count-1;
+        size_t middle = count>>1;
+
+        if (array[middle] < array[0]){ temp = array[middle]; array[middle] = array[0]; array[0] = temp; }
+        if (array[last] < array[middle]){ temp = array[last]; array[last] = array[middle]; array[middle] = temp; }
+        if (array[middle] < array[0]){ temp = array[middle]; array[middle] = array[0]; array[0] = temp; }
+        temp = array[middle]; array[middle] = array[last]; array[last] = temp;
+
+        size_t pivot = SORT_NAME(Sort_partition_block)(array, last);
+        size_t right_count = count - pivot - 1;
+
+        if (pivot < right_count){
+            SORT_NAME(Sort_quicksort_block)(array, pivot);
+            array += pivot+1;
+            count = right_count;
+        }
+        else{
+            SORT_NAME(Sort_quicksort_block)(array + pivot+1, right_count);
+            count = pivot;
+        }
+    }
+
+    SORT_NAME(Sort_insertion)(array, count);
+}
+
+
+
+#undef SORT_NAME
+#undef SORT_CAT
+#undef SORT_CAT_
+#undef SORT_TYPE
+#undef SORT_SUFFIX
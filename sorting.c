@@ -3,9 +3,17 @@
 #include <stdint.h>
 #include "binary_search_tree.h"
 #include "heapsort.h"
+#include "sort_common.h"
+#include "work_pool.h"
+#include <stdbool.h>
+#include <limits.h>
+#include <stdlib.h>
 
 /*  *********************** Private ************************ */
 
+// ranges this short are finished off with insertion sort by the quicksort variants
+#define INSERTION_SORT_THRESHOLD 16
+
 static void Swap_nodes_P(Node *node1, Node *node2){
     /* Swap the values in node1 and node2. 
 
@@ -31,11 +39,11 @@ static void Swap_index_values_P(char *index1, char *index2){
 };
 
 
-static uint16_t Partition_P(char the_array[], uint16_t index_start, uint16_t index_end){
-    uint16_t pivot_index = index_end; 
+static size_t Partition_P(char the_array[], size_t index_start, size_t index_end){
+    size_t pivot_index = index_end; 
     char pivot_value = the_array[index_end];
     
-    for (uint16_t current = index_start; current < pivot_index; current++){
+    for (size_t current = index_start; current < pivot_index; current++){
         if (the_array[current] > pivot_value){
             Swap_index_values_P(&the_array[current], &the_array[pivot_index]-1);
             Swap_index_values_P(&the_array[pivot_index-1], &the_array[pivot_index]);
@@ -49,11 +57,11 @@ static uint16_t Partition_P(char the_array[], uint16_t index_start, uint16_t ind
 
 
 
-static uint16_t Partition_hoare_P(char the_array[], uint16_t index_start, uint16_t index_end){
+static size_t Partition_hoare_P(char the_array[], size_t index_start, size_t index_end){
     char pivot_value = the_array[index_end];
-    uint16_t pivot_index = index_end;
-    uint16_t left = index_start;  
-    uint16_t right = index_end;
+    size_t pivot_index = index_end;
+    size_t left = index_start;  
+    size_t right = index_end;
 
 
     while (right > left){
@@ -73,6 +81,742 @@ static uint16_t Partition_hoare_P(char the_array[], uint16_t index_start, uint16
 };
 
 
+static size_t Partition_hoare_n_P(char the_array[], size_t index_start, size_t index_end){
+    /* size_t-indexed version of Partition_hoare_P(), for arrays of any length.
+
+       Unlike Partition_hoare_P(), both scans stop on elements equal to the
+       pivot. A char array longer than a few hundred items necessarily holds
+       long runs of equal values; letting the scans skip over them would put
+       all of a run on one side, and a range of equal values would only shrink
+       by one element per partition. Stopping on them and swapping splits
+       such ranges down the middle instead.
+
+       The caller must ensure the_array[index_start] <= pivot value (the last
+       element), which bounds the right-hand scan, the same way the pivot
+       itself bounds the left-hand scan.
+    */
+    char pivot_value = the_array[index_end];
+    size_t left = index_start;
+    size_t right = index_end;
+
+    for (;;){
+        while (the_array[left] < pivot_value){
+            left++;
+        };
+        do {
+            right--;
+        } while (pivot_value < the_array[right]);
+
+        if (left >= right){
+            break;
+        };
+        Swap_index_values_P(&the_array[left], &the_array[right]);
+        left++;
+    };
+
+    Swap_index_values_P(&the_array[left], &the_array[index_end]);
+    return left;
+};
+
+
+
+// number of items Partition_block_P() classifies at a time on either side
+#define PARTITION_BLOCK_SIZE 64
+
+static size_t Partition_block_P(char the_array[], size_t index_start, size_t index_end){
+    /* Block partition (BlockQuicksort), around the last item as pivot.
+
+       Partition_hoare_P() has to branch on the outcome of every comparison,
+       and on random data, those branches are about as predictable as a coin toss.
+       Here, the comparisons are done a block of PARTITION_BLOCK_SIZE items at
+       a time on each side, and their outcomes aren't branched on: the offset of
+       every item is written to the block's offsets buffer, but the buffer's
+       count is only incremented (by the 0/1 result of the comparison) for the
+       items that are on the wrong side. Then the misplaced items recorded on
+       the left are swapped with the ones recorded on the right, in bulk.
+       The only branches left are the loop conditions, which are predictable.
+
+       As in Partition_hoare_n_P(), items equal to the pivot count as misplaced
+       on both sides, so runs of equal items are split evenly.
+       Once fewer than two blocks' worth of items are left in between the two
+       sides, the rest is partitioned the ordinary way.
+    */
+    char pivot_value = the_array[index_end];
+    unsigned char offsets_left[PARTITION_BLOCK_SIZE];
+    unsigned char offsets_right[PARTITION_BLOCK_SIZE];
+    size_t start_left = 0, count_left = 0;
+    size_t start_right = 0, count_right = 0;
+
+    // [first, last) is the section not yet partitioned
+    size_t first = index_start;
+    size_t last = index_end;
+
+    while (last - first > 2*PARTITION_BLOCK_SIZE){
+        if (count_left == 0){
+            start_left = 0;
+            for (size_t i = 0; i < PARTITION_BLOCK_SIZE; i++){
+                offsets_left[count_left] = (unsigned char)i;
+                count_left += !(the_array[first+i] < pivot_value);
+            };
+        };
+        if (count_right == 0){
+            start_right = 0;
+            for (size_t i = 0; i < PARTITION_BLOCK_SIZE; i++){
+                offsets_right[count_right] = (unsigned char)i;
+                count_right += !(pivot_value < the_array[last-1-i]);
+            };
+        };
+
+        size_t swaps = (count_left < count_right) ? count_left : count_right;
+        for (size_t i = 0; i < swaps; i++){
+            Swap_index_values_P(&the_array[first + offsets_left[start_left+i]],
+                                &the_array[last-1 - offsets_right[start_right+i]]);
+        };
+        count_left -= swaps;
+        count_right -= swaps;
+        start_left += swaps;
+        start_right += swaps;
+
+        // a block is done with once all of its misplaced items have been swapped out
+        if (count_left == 0){
+            first += PARTITION_BLOCK_SIZE;
+        };
+        if (count_right == 0){
+            last -= PARTITION_BLOCK_SIZE;
+        };
+    };
+
+    // the rest, including a block that may still have misplaced items in it
+    for (;;){
+        while (first < last && the_array[first] < pivot_value){
+            first++;
+        };
+        while (first < last && pivot_value < the_array[last-1]){
+            last--;
+        };
+        if (last - first < 2){
+            // if a single item is left, it's equal to the pivot and can stay put
+            break;
+        };
+        Swap_index_values_P(&the_array[first], &the_array[last-1]);
+        first++;
+        last--;
+    };
+
+    Swap_index_values_P(&the_array[first], &the_array[index_end]);
+    return first;
+};
+
+
+
+static void Median_of_three_P(char the_array[], size_t index_start, size_t index_end){
+    /* Order the first, middle and last items, then swap the median of the
+       three into the last position, where the partition routines take the
+       pivot from. Leaves the_array[index_start] <= pivot.
+    */
+    size_t middle = index_start + ((index_end - index_start)>>1);
+
+    if (the_array[middle] < the_array[index_start]){
+        Swap_index_values_P(&the_array[middle], &the_array[index_start]);
+    };
+    if (the_array[index_end] < the_array[middle]){
+        Swap_index_values_P(&the_array[index_end], &the_array[middle]);
+    };
+    if (the_array[middle] < the_array[index_start]){
+        Swap_index_values_P(&the_array[middle], &the_array[index_start]);
+    };
+    Swap_index_values_P(&the_array[middle], &the_array[index_end]);
+};
+
+
+
+static void Insertion_range_P(char the_array[], size_t array_length){
+    /* Straight insertion sort, used to finish off short ranges.
+       Unlike Sort_insertion_array(), the scan for the insertion point stops
+       as soon as it reaches a smaller item, so it runs in linear time on a
+       range that's already nearly in order, as quicksort leaves them.
+    */
+    for (size_t current_index = 1; current_index < array_length; current_index++){
+        char value = the_array[current_index];
+        size_t j = current_index;
+
+        while (j > 0 && value < the_array[j-1]){
+            the_array[j] = the_array[j-1];
+            j--;
+        };
+        the_array[j] = value;
+    };
+};
+
+
+
+static void Introsort_P(char the_array[], size_t array_length, unsigned int depth_limit){
+    /* Quicksort the_array as in Sort_quicksort_array_n(), but give up on
+       partitioning once depth_limit levels of it have been used up along the
+       current path, and heapsort whatever range is left at that point.
+    */
+    while (array_length > INSERTION_SORT_THRESHOLD){
+        if (depth_limit == 0){
+            Heap_sort_n(the_array, array_length);
+            return;
+        };
+        depth_limit--;
+
+        Median_of_three_P(the_array, 0, array_length-1);
+        size_t pivot = Partition_hoare_n_P(the_array, 0, array_length-1);
+        size_t right_length = array_length - pivot - 1;
+
+        if (pivot < right_length){
+            Introsort_P(the_array, pivot, depth_limit);
+            the_array += pivot+1;
+            array_length = right_length;
+        }
+        else{
+            Introsort_P(the_array + pivot+1, right_length, depth_limit);
+            array_length = pivot;
+        };
+    };
+
+    Insertion_range_P(the_array, array_length);
+};
+
+
+
+static void Partition_three_way_P(char the_array[], size_t array_length,
+                                  size_t *equal_start, size_t *equal_end){
+    /* Three-way (Dutch national flag) partition around the value of the last item.
+
+       The range ends up split into three sections:
+            [0, *equal_start)               items < pivot
+            [*equal_start, *equal_end)      items == pivot
+            [*equal_end, array_length)      items > pivot
+
+       A single left-to-right pass is made. lower marks the end of the < section,
+       and upper the start of the > section; the items in between lower and
+       current are the ones equal to the pivot.
+    */
+    char pivot_value = the_array[array_length-1];
+    size_t lower = 0;
+    size_t current = 0;
+    size_t upper = array_length;
+
+    while (current < upper){
+        if (the_array[current] < pivot_value){
+            Swap_index_values_P(&the_array[lower], &the_array[current]);
+            lower++;
+            current++;
+        }
+        else if (pivot_value < the_array[current]){
+            upper--;
+            Swap_index_values_P(&the_array[current], &the_array[upper]);
+        }
+        else{
+            current++;
+        };
+    };
+
+    *equal_start = lower;
+    *equal_end = upper;
+};
+
+
+
+/* ---------------- Pattern-defeating quicksort helpers ---------------- */
+
+// above this length, pdqsort picks its pivot as a pseudo-median of nine
+#define PDQSORT_NINTHER_THRESHOLD 128
+// a partial insertion sort gives up after moving this many items
+#define PDQSORT_PARTIAL_INSERTION_LIMIT 8
+
+
+static void Sort_three_P(char the_array[], size_t a, size_t b, size_t c){
+    /* Order the items at indices a, b and c so that
+       the_array[a] <= the_array[b] <= the_array[c]. */
+    if (the_array[b] < the_array[a]){
+        Swap_index_values_P(&the_array[b], &the_array[a]);
+    };
+    if (the_array[c] < the_array[b]){
+        Swap_index_values_P(&the_array[c], &the_array[b]);
+    };
+    if (the_array[b] < the_array[a]){
+        Swap_index_values_P(&the_array[b], &the_array[a]);
+    };
+};
+
+
+
+static bool Partial_insertion_P(char the_array[], size_t array_length){
+    /* Insertion sort that gives up once it's had to move more than
+       PDQSORT_PARTIAL_INSERTION_LIMIT items in total.
+       Returns true if the_array was sorted completely.
+    */
+    size_t moved = 0;
+
+    for (size_t current_index = 1; current_index < array_length; current_index++){
+        char value = the_array[current_index];
+        size_t j = current_index;
+
+        while (j > 0 && value < the_array[j-1]){
+            the_array[j] = the_array[j-1];
+            j--;
+        };
+        the_array[j] = value;
+
+        moved += current_index - j;
+        if (moved > PDQSORT_PARTIAL_INSERTION_LIMIT){
+            return false;
+        };
+    };
+    return true;
+};
+
+
+
+static size_t Partition_right_P(char the_array[], size_t array_length, bool *already_partitioned){
+    /* Hoare-style partition, pivot taken from the last item as in Partition_hoare_P(),
+       putting the items < pivot to its left and the items >= pivot to its right.
+
+       *already_partitioned is set if not a single swap was needed, i.e. the
+       range was already split around the pivot. That's a strong hint the
+       range is (nearly) sorted.
+    */
+    size_t index_end = array_length-1;
+    char pivot_value = the_array[index_end];
+    size_t left = 0;
+    size_t right = index_end;
+
+    // the pivot stops this scan
+    while (the_array[left] < pivot_value){
+        left++;
+    };
+
+    // if the left scan moved, the item before left stops this scan; otherwise it has to be bounded
+    if (left == 0){
+        while (left < right && !(the_array[--right] < pivot_value)){
+        };
+    }
+    else{
+        while (!(the_array[--right] < pivot_value)){
+        };
+    };
+
+    *already_partitioned = left >= right;
+
+    // from here on, the last item swapped to either side acts as the sentinel for the scans
+    while (left < right){
+        Swap_index_values_P(&the_array[left], &the_array[right]);
+        while (the_array[++left] < pivot_value){
+        };
+        while (!(the_array[--right] < pivot_value)){
+        };
+    };
+
+    Swap_index_values_P(&the_array[left], &the_array[index_end]);
+    return left;
+};
+
+
+
+static size_t Partition_left_P(char the_array[], size_t array_length){
+    /* Mirror of Partition_right_P(): items <= pivot go to its left and
+       items > pivot to its right.
+
+       Only used when the pivot is equal to the item before the range (the
+       pivot of an enclosing partition), in which case no item in the range
+       is smaller than the pivot, and everything that ends up on its left
+       is equal to it and needs no further sorting.
+    */
+    size_t index_end = array_length-1;
+    char pivot_value = the_array[index_end];
+    size_t left = 0;
+    size_t right = index_end;
+
+    for (;;){
+        while (left < right && !(pivot_value < the_array[left])){
+            left++;
+        };
+        while (left < right && pivot_value < the_array[right-1]){
+            right--;
+        };
+        if (left >= right){
+            break;
+        };
+        Swap_index_values_P(&the_array[left], &the_array[right-1]);
+        left++;
+        right--;
+    };
+
+    Swap_index_values_P(&the_array[left], &the_array[index_end]);
+    return left;
+};
+
+
+
+static void Break_patterns_P(char the_array[], size_t array_length){
+    /* Swap a few items of an unbalanced partition with items from other
+       parts of it, so the pivots chosen next differ from those the input's
+       pattern made us pick this time. */
+    size_t quarter = array_length/4;
+
+    Swap_index_values_P(&the_array[0], &the_array[quarter]);
+    Swap_index_values_P(&the_array[array_length-1], &the_array[array_length - quarter]);
+
+    if (array_length > PDQSORT_NINTHER_THRESHOLD){
+        Swap_index_values_P(&the_array[1], &the_array[quarter+1]);
+        Swap_index_values_P(&the_array[2], &the_array[quarter+2]);
+        Swap_index_values_P(&the_array[array_length-2], &the_array[array_length - (quarter+1)]);
+        Swap_index_values_P(&the_array[array_length-3], &the_array[array_length - (quarter+2)]);
+    };
+};
+
+
+
+static void Pdqsort_P(char the_array[], size_t array_length, unsigned int bad_allowed, bool leftmost){
+    /* The body of Sort_pdqsort_array(). leftmost is false when the item
+       right before the_array[0] is the pivot of an enclosing partition. */
+    while (array_length > INSERTION_SORT_THRESHOLD){
+        size_t half = array_length/2;
+
+        // pivot selection: the median goes to the last item
+        if (array_length > PDQSORT_NINTHER_THRESHOLD){
+            Sort_three_P(the_array, 0, half, array_length-1);
+            Sort_three_P(the_array, 1, half-1, array_length-2);
+            Sort_three_P(the_array, 2, half+1, array_length-3);
+            Sort_three_P(the_array, half-1, half, half+1);
+        }
+        else{
+            Sort_three_P(the_array, 0, half, array_length-1);
+        };
+        Swap_index_values_P(&the_array[half], &the_array[array_length-1]);
+
+        // a pivot equal to the enclosing one: put the run of items equal to it aside
+        if (!leftmost && !(the_array[-1] < the_array[array_length-1])){
+            size_t pivot = Partition_left_P(the_array, array_length);
+            the_array += pivot+1;
+            array_length -= pivot+1;
+            continue;
+        };
+
+        bool already_partitioned;
+        size_t pivot = Partition_right_P(the_array, array_length, &already_partitioned);
+        size_t left_length = pivot;
+        size_t right_length = array_length - pivot - 1;
+        bool highly_unbalanced = left_length < array_length/8 || right_length < array_length/8;
+
+        if (highly_unbalanced){
+            if (--bad_allowed == 0){
+                Heap_sort_n(the_array, array_length);
+                return;
+            };
+            if (left_length >= INSERTION_SORT_THRESHOLD){
+                Break_patterns_P(the_array, left_length);
+            };
+            if (right_length >= INSERTION_SORT_THRESHOLD){
+                Break_patterns_P(the_array + pivot+1, right_length);
+            };
+        }
+        else if (already_partitioned){
+            // likely sorted or nearly so: try to finish both sides off in linear time
+            if (Partial_insertion_P(the_array, left_length)
+                && Partial_insertion_P(the_array + pivot+1, right_length)){
+                return;
+            };
+        };
+
+        if (left_length < right_length){
+            Pdqsort_P(the_array, left_length, bad_allowed, leftmost);
+            the_array += pivot+1;
+            array_length = right_length;
+            leftmost = false;
+        }
+        else{
+            Pdqsort_P(the_array + pivot+1, right_length, bad_allowed, false);
+            array_length = left_length;
+        };
+    };
+
+    Insertion_range_P(the_array, array_length);
+};
+
+
+
+// ranges this short are left to insertion sort by the dual-pivot quicksort
+#define DUAL_PIVOT_INSERTION_THRESHOLD 27
+
+static void Partition_dual_pivot_P(char the_array[], size_t array_length,
+                                   size_t *lower_pivot, size_t *upper_pivot){
+    /* Yaroslavskiy's dual-pivot partition.
+
+       Two pivots p <= q are taken from the first and last items, and the range
+       is split in a single pass into three sections:
+            [0, *lower_pivot)                   items < p
+            (*lower_pivot, *upper_pivot)        p <= items <= q
+            (*upper_pivot, array_length)        items > q
+       with p and q placed at *lower_pivot and *upper_pivot.
+
+       less marks the end of the < p section, and great the start of the > q
+       section; current scans the items in between.
+    */
+    if (the_array[array_length-1] < the_array[0]){
+        Swap_index_values_P(&the_array[0], &the_array[array_length-1]);
+    };
+    char p = the_array[0];
+    char q = the_array[array_length-1];
+
+    size_t less = 1;
+    size_t great = array_length-2;
+
+    for (size_t current = 1; current <= great; current++){
+        if (the_array[current] < p){
+            Swap_index_values_P(&the_array[current], &the_array[less]);
+            less++;
+        }
+        else if (q < the_array[current]){
+            while (q < the_array[great] && current < great){
+                great--;
+            };
+            Swap_index_values_P(&the_array[current], &the_array[great]);
+            great--;
+
+            // the item swapped in from the right end may belong in the < p section
+            if (the_array[current] < p){
+                Swap_index_values_P(&the_array[current], &the_array[less]);
+                less++;
+            };
+        };
+    };
+
+    less--;
+    great++;
+    Swap_index_values_P(&the_array[0], &the_array[less]);
+    Swap_index_values_P(&the_array[array_length-1], &the_array[great]);
+
+    *lower_pivot = less;
+    *upper_pivot = great;
+};
+
+
+
+// below this many items, the parallel quicksort stops forking and sorts sequentially
+#define PARALLEL_QUICKSORT_CUTOFF 32768
+
+static void Quicksort_task_P(WorkPool pool, void *context, size_t index_start, size_t array_length){
+    /* Pool task sorting array_length items from index_start in the char array
+       pointed to by context.
+
+       Each partition forks: the larger side is submitted to the pool as a new
+       task, for an idle thread to steal, and the smaller side is carried on
+       with by this one. Ranges below PARALLEL_QUICKSORT_CUTOFF items are
+       sorted sequentially by Sort_pdqsort_array(), as are ranges that
+       partition very unevenly: pdqsort has the means to deal with the input
+       patterns that cause that, and its O(n log n) worst case.
+    */
+    char *the_array = (char *)context + index_start;
+
+    while (array_length > PARALLEL_QUICKSORT_CUTOFF){
+        Median_of_three_P(the_array, 0, array_length-1);
+        size_t pivot = Partition_hoare_n_P(the_array, 0, array_length-1);
+        size_t right_length = array_length - pivot - 1;
+        size_t smaller = (pivot < right_length) ? pivot : right_length;
+
+        if (smaller < array_length/8){
+            break;
+        };
+
+        if (pivot < right_length){
+            Pool_submit(pool, Quicksort_task_P, context, index_start + pivot+1, right_length);
+            array_length = pivot;
+        }
+        else{
+            Pool_submit(pool, Quicksort_task_P, context, index_start, pivot);
+            the_array += pivot+1;
+            index_start += pivot+1;
+            array_length = right_length;
+        };
+    };
+
+    Sort_pdqsort_array(the_array, array_length);
+};
+
+
+
+static void Byte_histogram_P(const unsigned char bytes[], size_t length, size_t counts[256]){
+    /* Count the occurrences of each byte value in bytes.
+
+       Four separate histograms are kept, each item going to the next one in
+       turn, and added up at the end. With a single histogram, a run of equal
+       bytes -- common in sorted or low-cardinality data -- makes every increment
+       wait for the previous increment of the same counter to be stored before it
+       can load it again. With four, consecutive increments hit different
+       counters and can overlap.
+    */
+    size_t partial[4][256] = {{0}};
+    size_t i = 0;
+
+    for (; i + 4 <= length; i += 4){
+        partial[0][bytes[i]]++;
+        partial[1][bytes[i+1]]++;
+        partial[2][bytes[i+2]]++;
+        partial[3][bytes[i+3]]++;
+    };
+    for (; i < length; i++){
+        partial[0][bytes[i]]++;
+    };
+
+    for (size_t value = 0; value < 256; value++){
+        counts[value] = partial[0][value] + partial[1][value] + partial[2][value] + partial[3][value];
+    };
+};
+
+
+
+static void Insertion_generic_P(char *array, size_t count, size_t size, Sort_compare_fn compare){
+    /* Insertion sort for Sort_insertion_generic() and Sort_bytes_generic_P().
+       Each new element is swapped leftwards into the sorted section until
+       the element to its left is no greater than it.
+    */
+    for (size_t current_index = 1; current_index < count; current_index++){
+        for (size_t j = current_index; j > 0; j--){
+            if (compare(array + (j-1)*size, array + j*size) <= 0){
+                break;
+            };
+            Sort_swap_elements(array + (j-1)*size, array + j*size, size);
+        };
+    };
+};
+
+
+
+static void Sort_bytes_generic_P(unsigned char bytes[], size_t length, Sort_compare_fn compare){
+    /* Counting sort for 1-byte elements ordered by an arbitrary comparator.
+
+       A 1-byte element is entirely described by its value, so the array can be
+       rebuilt from a histogram alone. Only the distinct values that occur --
+       256 at most -- are sorted with the comparator, then each is written out
+       as many times as it occurred.
+    */
+    size_t counts[256];
+    unsigned char values[256];
+    size_t distinct = 0;
+
+    Byte_histogram_P(bytes, length, counts);
+
+    for (size_t value = 0; value < 256; value++){
+        if (counts[value]){
+            values[distinct++] = (unsigned char)value;
+        };
+    };
+    Insertion_generic_P((char *)values, distinct, 1, compare);
+
+    for (size_t i = 0; i < distinct; i++){
+        memset(bytes, values[i], counts[values[i]]);
+        bytes += counts[values[i]];
+    };
+};
+
+
+
+// below this many items, the parallel counting sort leaves it to Sort_counting_array()
+#define PARALLEL_COUNTING_CUTOFF (1u<<20)
+
+struct counting_job{
+    char *the_array;
+    size_t array_length;
+    size_t chunks;              // number of tasks per phase
+    size_t (*histograms)[256];  // one per chunk, then reused for the values' output positions
+};
+
+static void Counting_histogram_task_P(WorkPool pool, void *context, size_t chunk, size_t unused){
+    /* Phase 1 of Sort_counting_parallel_array(): histogram of one chunk */
+    struct counting_job *job = context;
+    size_t start = job->array_length / job->chunks * chunk;
+    size_t end = (chunk == job->chunks-1) ? job->array_length : start + job->array_length / job->chunks;
+    (void)pool;
+    (void)unused;
+
+    Byte_histogram_P((const unsigned char *)job->the_array + start, end - start, job->histograms[chunk]);
+};
+
+static void Counting_fill_task_P(WorkPool pool, void *context, size_t chunk, size_t unused){
+    /* Phase 2 of Sort_counting_parallel_array(): write out one chunk of the
+       sorted array. histograms[0][value] now holds the position where value
+       starts in the output, and histograms[1][value] where it ends. */
+    struct counting_job *job = context;
+    size_t start = job->array_length / job->chunks * chunk;
+    size_t end = (chunk == job->chunks-1) ? job->array_length : start + job->array_length / job->chunks;
+    (void)pool;
+    (void)unused;
+
+    for (int value = CHAR_MIN; value <= CHAR_MAX && start < end; value++){
+        size_t value_end = job->histograms[1][(unsigned char)value];
+        if (value_end > start){
+            size_t fill_end = (value_end < end) ? value_end : end;
+            memset(job->the_array + start, value, fill_end - start);
+            start = fill_end;
+        };
+    };
+};
+
+
+
+static void Median_of_three_generic_P(char *base, size_t index_start, size_t index_end,
+                                     size_t size, Sort_compare_fn compare){
+    /* Element-size-agnostic version of Median_of_three_P().
+       Leaves base[index_start] <= pivot (the last element).
+    */
+    char *first = base + index_start*size;
+    char *middle = base + (index_start + ((index_end - index_start)>>1))*size;
+    char *last = base + index_end*size;
+
+    if (compare(middle, first) < 0){
+        Sort_swap_elements(middle, first, size);
+    };
+    if (compare(last, middle) < 0){
+        Sort_swap_elements(last, middle, size);
+    };
+    if (compare(middle, first) < 0){
+        Sort_swap_elements(middle, first, size);
+    };
+    Sort_swap_elements(middle, last, size);
+};
+
+
+
+static size_t Partition_hoare_generic_P(char *base, size_t index_start, size_t index_end,
+                                        size_t size, Sort_compare_fn compare){
+    /* Element-size-agnostic version of Partition_hoare_n_P(): both scans
+       stop on elements equal to the pivot, so runs of equal keys are split
+       evenly rather than all ending up on one side.
+       The pivot (the last element) is never moved until the final swap,
+       so it can be compared against in place, through a pointer.
+
+       The caller must ensure base[index_start] <= pivot, as
+       Median_of_three_generic_P() does.
+    */
+    char *pivot_value = base + index_end*size;
+    size_t left = index_start;
+    size_t right = index_end;
+
+    for (;;){
+        while (compare(base + left*size, pivot_value) < 0){
+            left++;
+        };
+        do {
+            right--;
+        } while (compare(pivot_value, base + right*size) < 0);
+
+        if (left >= right){
+            break;
+        };
+        Sort_swap_elements(base + left*size, base + right*size, size);
+        left++;
+    };
+
+    Sort_swap_elements(base + left*size, pivot_value, size);
+    return left;
+};
+
+
 /*  *********************** End Private************************ */
 
 
@@ -391,6 +1135,438 @@ void Sort_quicksort_array(char the_array[], uint16_t index_start, uint16_t index
 
 
 
+void Sort_quicksort_array_n(char the_array[], size_t array_length){
+    /* Sort the first array_length items of the_array using quicksort.
+
+       Same as Sort_quicksort_array(), but indexed with size_t, so it works for
+       arrays of any length the address space allows, not just up to 65,535
+       items. Taking a length instead of an inclusive end index also lets an
+       empty array be passed in.
+
+       To keep it usable on inputs that large:
+        - the pivot is the median of the first, middle and last items rather than
+          always the last one, so sorted and reverse-sorted arrays don't degrade
+          to quadratic time (see Median_of_three_P());
+        - equal items are split evenly between the partitions (see
+          Partition_hoare_n_P());
+        - only the smaller partition is recursed on. The larger one is handled by
+          the loop, in the same stack frame. Since the smaller partition is at most
+          half the size of the range, the recursion is at most log2(array_length)
+          levels deep, i.e. under 64 for any size_t length.
+    */
+    while (array_length > 2){
+        Median_of_three_P(the_array, 0, array_length-1);
+        size_t pivot = Partition_hoare_n_P(the_array, 0, array_length-1);
+        size_t right_length = array_length - pivot - 1;
+
+        if (pivot < right_length){
+            Sort_quicksort_array_n(the_array, pivot);
+            the_array += pivot+1;
+            array_length = right_length;
+        }
+        else{
+            Sort_quicksort_array_n(the_array + pivot+1, right_length);
+            array_length = pivot;
+        };
+    };
+
+    if (array_length == 2 && the_array[0] > the_array[1]){
+        Swap_index_values_P(&the_array[0], &the_array[1]);
+    };
+};
+
+
+
+void Sort_introsort_array(char the_array[], size_t array_length){
+    /* Sort the first array_length items of the_array using introsort.
+
+       Introsort combines the three sorts implemented here:
+        - quicksort (as in Sort_quicksort_array_n()) does the bulk of the work;
+        - the recursion depth is tracked, and once it exceeds 2*log2(array_length)
+          -- meaning the pivots have been consistently bad -- the range being
+          worked on is handed over to heapsort (Heap_sort_n());
+        - ranges of INSERTION_SORT_THRESHOLD items or fewer aren't partitioned
+          further, but finished off with insertion sort.
+
+       ---------------- Performance notes -------------------
+       The worst case is O(n log n) whatever the input: quicksort can only do
+       O(log n) levels of O(n) partitioning work before heapsort takes over,
+       and heapsort is O(n log n). On typical inputs, heapsort is never reached
+       and this runs as fast as quicksort.
+    */
+    unsigned int depth_limit = 0;
+
+    for (size_t n = array_length; n > 1; n >>= 1){
+        depth_limit += 2;
+    };
+
+    Introsort_P(the_array, array_length, depth_limit);
+};
+
+
+
+void Sort_pdqsort_array(char the_array[], size_t array_length){
+    /* Sort the first array_length items of the_array using pattern-defeating
+       quicksort (pdqsort).
+
+       Like Sort_introsort_array(), this is quicksort with a heapsort fallback
+       and an insertion sort finish, plus a few things that target inputs with
+       patterns in them:
+        - the pivot is a median of three, or a pseudo-median of nine items on
+          ranges longer than PDQSORT_NINTHER_THRESHOLD;
+        - a partition that needed no swaps at all suggests the range is already
+          sorted; both sides are then insertion sorted, giving up if more than a
+          few items have to be moved. Sorted and nearly sorted inputs are thus
+          done in linear time;
+        - a highly unbalanced partition (a side smaller than 1/8 of the range)
+          has a few of its items swapped around to break up whatever pattern led
+          to it. Only log2(array_length) such partitions are allowed; after that
+          the range is heapsorted (Heap_sort_n()), for an O(n log n) worst case;
+        - when the pivot is equal to the pivot of the enclosing partition, all
+          the items equal to it are gathered on its left and skipped, so runs of
+          equal items are done in linear time.
+    */
+    unsigned int bad_allowed = 1;
+
+    for (size_t n = array_length; n > 1; n >>= 1){
+        bad_allowed++;
+    };
+
+    Pdqsort_P(the_array, array_length, bad_allowed, true);
+};
+
+
+
+void Sort_quicksort_3way_array(char the_array[], size_t array_length){
+    /* Sort the first array_length items of the_array using quicksort with
+       three-way partitioning (see Partition_three_way_P()).
+
+       All the items equal to the pivot are gathered in the middle by the
+       partition and left out of both recursive calls, so each distinct value
+       only gets to be a pivot once. Since a char can only take 256 distinct
+       values, this bounds the partitioning work to O(n * min(log n, 256))
+       whatever the input, and makes it linear on inputs with only a handful
+       of distinct values, where two-way partitioning keeps going over the
+       same equal items level after level.
+
+       As in Sort_quicksort_array_n(), the pivot is a median of three, and only
+       the smaller side is recursed on.
+    */
+    while (array_length > INSERTION_SORT_THRESHOLD){
+        size_t equal_start, equal_end;
+
+        Median_of_three_P(the_array, 0, array_length-1);
+        Partition_three_way_P(the_array, array_length, &equal_start, &equal_end);
+
+        size_t right_length = array_length - equal_end;
+
+        if (equal_start < right_length){
+            Sort_quicksort_3way_array(the_array, equal_start);
+            the_array += equal_end;
+            array_length = right_length;
+        }
+        else{
+            Sort_quicksort_3way_array(the_array + equal_end, right_length);
+            array_length = equal_start;
+        };
+    };
+
+    Insertion_range_P(the_array, array_length);
+};
+
+
+
+void Sort_quicksort_partition_array(char the_array[], size_t array_length, Sort_partition_scheme scheme){
+    /* Quicksort the first array_length items of the_array, partitioning with
+       the selected scheme:
+        SORT_PARTITION_LOMUTO     Partition_P()
+        SORT_PARTITION_HOARE      Partition_hoare_P()
+        SORT_PARTITION_BLOCK      Partition_block_P()
+
+       Everything else is the same for all three, so they can be compared on
+       equal footing: median of three pivot, insertion sort for short ranges,
+       recursion on the smaller side only.
+
+       ---------------- Performance notes -------------------
+       Partition_P() and Partition_hoare_P() put all items equal to the pivot
+       on the same side, so they slow down to quadratic time on inputs with
+       long runs of equal items -- which, for char, means any input much longer
+       than 256 items. SORT_PARTITION_BLOCK splits equal items evenly.
+    */
+    size_t (*partition)(char [], size_t, size_t) = Partition_block_P;
+
+    if (scheme == SORT_PARTITION_LOMUTO){
+        partition = Partition_P;
+    }
+    else if (scheme == SORT_PARTITION_HOARE){
+        partition = Partition_hoare_P;
+    };
+
+    while (array_length > INSERTION_SORT_THRESHOLD){
+        Median_of_three_P(the_array, 0, array_length-1);
+        size_t pivot = partition(the_array, 0, array_length-1);
+        size_t right_length = array_length - pivot - 1;
+
+        if (pivot < right_length){
+            Sort_quicksort_partition_array(the_array, pivot, scheme);
+            the_array += pivot+1;
+            array_length = right_length;
+        }
+        else{
+            Sort_quicksort_partition_array(the_array + pivot+1, right_length, scheme);
+            array_length = pivot;
+        };
+    };
+
+    Insertion_range_P(the_array, array_length);
+};
+
+
+
+void Sort_quicksort_iterative_array(char the_array[], size_t array_length){
+    /* Sort the first array_length items of the_array using quicksort,
+       without recursion.
+
+       The ranges still to be sorted are kept on an explicit stack, in an
+       array local to this function. After each partition, the larger side is
+       pushed, and the smaller side is carried on with right away. That way,
+       every range on the stack is more than twice as long as the one pushed
+       after it, so there can never be more than log2(array_length) ranges
+       on it -- fewer than the number of bits in a size_t. The stack therefore
+       has a fixed size, and this uses O(log n) auxiliary space and a constant
+       amount of the call stack, whatever the input.
+
+       Partitioning is the same as in Sort_quicksort_array_n(), and ranges of
+       INSERTION_SORT_THRESHOLD items or fewer are finished with insertion sort.
+    */
+    struct {
+        size_t start;
+        size_t length;
+    } stack[sizeof(size_t) * CHAR_BIT];
+    size_t stack_size = 0;
+
+    size_t start = 0;
+    size_t length = array_length;
+
+    for (;;){
+        if (length > INSERTION_SORT_THRESHOLD){
+            char *range = the_array + start;
+            Median_of_three_P(range, 0, length-1);
+            size_t pivot = Partition_hoare_n_P(range, 0, length-1);
+            size_t right_length = length - pivot - 1;
+
+            if (pivot < right_length){
+                stack[stack_size].start = start + pivot+1;
+                stack[stack_size].length = right_length;
+                length = pivot;
+            }
+            else{
+                stack[stack_size].start = start;
+                stack[stack_size].length = pivot;
+                start += pivot+1;
+                length = right_length;
+            };
+            stack_size++;
+            continue;
+        };
+
+        Insertion_range_P(the_array + start, length);
+
+        if (stack_size == 0){
+            break;
+        };
+        stack_size--;
+        start = stack[stack_size].start;
+        length = stack[stack_size].length;
+    };
+};
+
+
+
+void Sort_quicksort_dual_pivot_array(char the_array[], size_t array_length){
+    /* Sort the first array_length items of the_array using Yaroslavskiy's
+       dual-pivot quicksort (see Partition_dual_pivot_P()).
+
+       Splitting each range three ways rather than two makes for fewer levels of
+       partitioning, log3(n) rather than log2(n), and so fewer passes over the
+       array. Each pass does a bit more work per item, but memory traffic, not
+       comparisons, is what limits the sorting of large arrays.
+
+       The pivots are the items at one and two thirds of the range, moved to its
+       ends. If they're equal, every item in the middle section is equal to them,
+       and the middle section isn't sorted any further.
+
+       Ranges of DUAL_PIVOT_INSERTION_THRESHOLD items or fewer are finished
+       with insertion sort. Of the three sections, the two smaller ones are
+       recursed on and the largest one is looped on, keeping the recursion
+       O(log n) deep.
+    */
+    while (array_length > DUAL_PIVOT_INSERTION_THRESHOLD){
+        size_t third = array_length/3;
+        Swap_index_values_P(&the_array[third], &the_array[0]);
+        Swap_index_values_P(&the_array[array_length-1-third], &the_array[array_length-1]);
+
+        size_t lower_pivot, upper_pivot;
+        Partition_dual_pivot_P(the_array, array_length, &lower_pivot, &upper_pivot);
+
+        // the three sections, as (start, length)
+        size_t starts[3] = {0, lower_pivot+1, upper_pivot+1};
+        size_t lengths[3] = {lower_pivot, upper_pivot - lower_pivot - 1, array_length - upper_pivot - 1};
+
+        if (!(the_array[lower_pivot] < the_array[upper_pivot])){
+            lengths[1] = 0;
+        };
+
+        size_t largest = 0;
+        for (size_t i = 1; i < 3; i++){
+            if (lengths[i] > lengths[largest]){
+                largest = i;
+            };
+        };
+        for (size_t i = 0; i < 3; i++){
+            if (i != largest){
+                Sort_quicksort_dual_pivot_array(the_array + starts[i], lengths[i]);
+            };
+        };
+
+        the_array += starts[largest];
+        array_length = lengths[largest];
+    };
+
+    Insertion_range_P(the_array, array_length);
+};
+
+
+
+void Sort_counting_array(char the_array[], size_t array_length){
+    /* Sort the first array_length items of the_array using counting sort.
+
+       A char can only hold 256 distinct values, so rather than comparing items,
+       a single pass over the_array counts how many times each value occurs
+       (see Byte_histogram_P()), then the_array is overwritten with each value,
+       from the smallest to the largest, repeated as many times as it was
+       counted, one memset() per value.
+
+       ---------------- Performance notes -------------------
+       O(n) time, and only the two sequential passes over the array: one read,
+       one write. The 256-entry histograms are the only extra space, so for
+       anything longer than a few hundred items, this beats every comparison
+       sort in this file by a wide margin.
+    */
+    size_t counts[256];
+
+    Byte_histogram_P((const unsigned char *)the_array, array_length, counts);
+
+    // char may be signed: go through the values in char order, not byte order
+    for (int value = CHAR_MIN; value <= CHAR_MAX; value++){
+        size_t count = counts[(unsigned char)value];
+        memset(the_array, value, count);
+        the_array += count;
+    };
+};
+
+
+
+void Sort_counting_parallel_array(char the_array[], size_t array_length, unsigned int threads){
+    /* Sort the first array_length items of the_array using counting sort
+       (as in Sort_counting_array()), on threads threads (0 for one per online CPU).
+
+       The array is cut into one chunk per thread, and the sort done in two
+       parallel phases, with a short sequential step in between:
+        1. each thread builds a private histogram of its own chunk;
+        2. the histograms are added up and turned, by a prefix sum over the
+           values in char order, into the range of output positions each value
+           is to fill;
+        3. each thread writes out its own chunk of the output, i.e. the parts
+           of the values' ranges that fall within it, with memset().
+       The threads never write to the same memory, so no locking is needed
+       beyond waiting for each phase to complete, and each of them reads and
+       then writes a contiguous, equally sized part of the array.
+
+       Arrays shorter than PARALLEL_COUNTING_CUTOFF items, or a failure to set
+       up the threads, fall back to the sequential Sort_counting_array().
+    */
+    if (threads == 1 || array_length < PARALLEL_COUNTING_CUTOFF){
+        Sort_counting_array(the_array, array_length);
+        return;
+    };
+
+    WorkPool pool = Pool_create(threads);
+    struct counting_job job = {the_array, array_length, 0, NULL};
+
+    if (pool){
+        job.chunks = Pool_threads(pool);
+        job.histograms = malloc((job.chunks < 2 ? 2 : job.chunks) * sizeof(size_t [256]));
+    };
+    if (!job.histograms){
+        Pool_destroy(&pool);
+        Sort_counting_array(the_array, array_length);
+        return;
+    };
+
+    for (size_t chunk = 0; chunk < job.chunks; chunk++){
+        Pool_submit(pool, Counting_histogram_task_P, &job, chunk, 0);
+    };
+    Pool_wait(pool);
+
+    // add the histograms up, then prefix sum into each value's [start, end) output range
+    size_t totals[256] = {0};
+    for (size_t chunk = 0; chunk < job.chunks; chunk++){
+        for (size_t value = 0; value < 256; value++){
+            totals[value] += job.histograms[chunk][value];
+        };
+    };
+    size_t position = 0;
+    for (int value = CHAR_MIN; value <= CHAR_MAX; value++){
+        job.histograms[0][(unsigned char)value] = position;
+        position += totals[(unsigned char)value];
+        job.histograms[1][(unsigned char)value] = position;
+    };
+
+    for (size_t chunk = 0; chunk < job.chunks; chunk++){
+        Pool_submit(pool, Counting_fill_task_P, &job, chunk, 0);
+    };
+    Pool_wait(pool);
+
+    free(job.histograms);
+    Pool_destroy(&pool);
+};
+
+
+
+void Sort_quicksort_parallel_array(char the_array[], size_t array_length, unsigned int threads){
+    /* Sort the first array_length items of the_array using quicksort, on
+       threads threads (0 for one per online CPU).
+
+       After each partition, the two sides are sorted as independent tasks on a
+       work-stealing thread pool (see work_pool.h and Quicksort_task_P()).
+       The calling thread takes part in the sorting.
+
+       If the thread pool can't be created, or threads is 1, the sorting is done
+       sequentially on the calling thread, by Sort_pdqsort_array().
+
+       ---------------- Performance notes -------------------
+       The first partition, over the whole array, is done by a single thread, and
+       only from then on do the partitions start running in parallel, so the
+       speedup levels off once the first few levels of partitioning dominate.
+    */
+    if (threads == 1 || array_length <= PARALLEL_QUICKSORT_CUTOFF){
+        Sort_pdqsort_array(the_array, array_length);
+        return;
+    };
+
+    WorkPool pool = Pool_create(threads);
+    if (!pool){
+        Sort_pdqsort_array(the_array, array_length);
+        return;
+    };
+
+    Pool_submit(pool, Quicksort_task_P, the_array, 0, array_length);
+    Pool_wait(pool);
+    Pool_destroy(&pool);
+};
+
+
 
 
 void Sort_heapsort_array(char the_array[], int32_t size){
@@ -438,3 +1614,135 @@ void Sort_treesort_array(char the_array[], unsigned int array_length){
 };
 
 
+
+
+/* ------------------------------------------------------------------------
+   Type-generic versions of the array routines above.
+   Same algorithms, but operating on count elements of size bytes each,
+   ordered by compare -- see sort_common.h.
+   ------------------------------------------------------------------------ */
+
+void Sort_bubble_generic(void *base, size_t count, size_t size, Sort_compare_fn compare){
+    /* Generic counterpart of Sort_bubble_array().
+       Arrays of 1-byte elements are counting sorted instead, as by all the
+       generic routines (see Sort_bytes_generic_P()).
+    */
+    char *array = base;
+
+    if (size == 1 && count > INSERTION_SORT_THRESHOLD){
+        Sort_bytes_generic_P(base, count, compare);
+        return;
+    };
+
+    for (size_t elements = count-1; count > 1 && elements > 0; elements--){
+        for (size_t j = 0; j < elements; j++){
+            if (compare(array + j*size, array + (j+1)*size) > 0){
+                Sort_swap_elements(array + j*size, array + (j+1)*size, size);
+            };
+        };
+    };
+};
+
+
+
+void Sort_selection_generic(void *base, size_t count, size_t size, Sort_compare_fn compare){
+    /* Generic counterpart of Sort_selection_array().
+       Only the index of the smallest element is tracked during a pass; the
+       element itself is only moved once, at the end of the pass.
+       Arrays of 1-byte elements are counting sorted instead.
+    */
+    char *array = base;
+
+    if (count < 2){
+        return;
+    };
+    if (size == 1 && count > INSERTION_SORT_THRESHOLD){
+        Sort_bytes_generic_P(base, count, compare);
+        return;
+    };
+
+    for (size_t current_index = 0; current_index < count-1; current_index++){
+        size_t smallest_value_index = current_index;
+
+        for (size_t j = current_index+1; j < count; j++){
+            if (compare(array + j*size, array + smallest_value_index*size) < 0){
+                smallest_value_index = j;
+            };
+        };
+
+        if (smallest_value_index != current_index){
+            Sort_swap_elements(array + current_index*size, array + smallest_value_index*size, size);
+        };
+    };
+};
+
+
+
+void Sort_insertion_generic(void *base, size_t count, size_t size, Sort_compare_fn compare){
+    /* Generic counterpart of Sort_insertion_array(); see Insertion_generic_P().
+       Arrays of 1-byte elements are counting sorted instead.
+    */
+    if (size == 1 && count > INSERTION_SORT_THRESHOLD){
+        Sort_bytes_generic_P(base, count, compare);
+        return;
+    };
+    Insertion_generic_P(base, count, size, compare);
+};
+
+
+
+void Sort_quicksort_generic(void *base, size_t count, size_t size, Sort_compare_fn compare){
+    /* Generic counterpart of Sort_quicksort_array_n(): the pivot is the
+       median of the first, middle and last elements, and equal elements are
+       split evenly between the partitions (see Partition_hoare_generic_P()),
+       so sorted, reverse-sorted and all-equal inputs take O(n log n) time.
+
+       Rather than recursing on both partitions, only the smaller one is
+       recursed on, and the larger one is handled by looping. This keeps the
+       depth of the recursion to O(log n).
+
+       Arrays of 1-byte elements are counting sorted instead, in linear time
+       (see Sort_bytes_generic_P()).
+    */
+    char *array = base;
+
+    if (size == 1 && count > INSERTION_SORT_THRESHOLD){
+        Sort_bytes_generic_P(base, count, compare);
+        return;
+    };
+
+    while (count > 2){
+        Median_of_three_generic_P(array, 0, count-1, size, compare);
+        size_t pivot = Partition_hoare_generic_P(array, 0, count-1, size, compare);
+        size_t left_count = pivot;
+        size_t right_count = count - pivot - 1;
+
+        if (left_count < right_count){
+            Sort_quicksort_generic(array, left_count, size, compare);
+            array += (pivot+1)*size;
+            count = right_count;
+        }
+        else{
+            Sort_quicksort_generic(array + (pivot+1)*size, right_count, size, compare);
+            count = left_count;
+        };
+    };
+
+    if (count == 2 && compare(array, array + size) > 0){
+        Sort_swap_elements(array, array + size, size);
+    };
+};
+
+
+
+void Sort_heapsort_generic(void *base, size_t count, size_t size, Sort_compare_fn compare){
+    /* Generic counterpart of Sort_heapsort_array().
+       The implementation is in heapsort.c.
+       Arrays of 1-byte elements are counting sorted instead.
+    */
+    if (size == 1 && count > INSERTION_SORT_THRESHOLD){
+        Sort_bytes_generic_P(base, count, compare);
+        return;
+    };
+    Heap_sort_generic(base, count, size, compare);
+};
@@ -18,6 +18,17 @@
 
 /* *********************** Includes ******************* */
 #include "singly_linked_list.h"
+#include "sort_common.h"
+
+
+/* *********************** Types ******************* */
+
+/* Partition schemes Sort_quicksort_partition_array() can be run with */
+typedef enum {
+    SORT_PARTITION_LOMUTO,  // Lomuto-style partition, one scan from the left
+    SORT_PARTITION_HOARE,   // Hoare partition, two scans towards each other
+    SORT_PARTITION_BLOCK    // BlockQuicksort: branchless, block-at-a-time Hoare partition
+} Sort_partition_scheme;
 
 
 /* /////////////////////////////////////////////////////////////////
@@ -57,6 +68,47 @@ void Sort_insertion_array(char chararray[], unsigned int array_length);
 /* Array-version implementation of the Quicksort algorithm*/ 
 void Sort_quicksort_array(char the_array[], uint16_t index_start, uint16_t index_end);
 
+/* Quicksort on the first array_length items of the_array, for arrays of any
+ * length. Recursion depth is bounded by log2(array_length). */
+void Sort_quicksort_array_n(char the_array[], size_t array_length);
+
+/* Introsort: quicksort that switches to heapsort once the recursion gets
+ * too deep, and to insertion sort for short ranges. O(n log n) worst case. */
+void Sort_introsort_array(char the_array[], size_t array_length);
+
+/* Pattern-defeating quicksort: introsort that also detects already
+ * partitioned ranges, breaks up patterns causing bad partitions and skips runs
+ * of equal items. Linear time on sorted and nearly sorted input. */
+void Sort_pdqsort_array(char the_array[], size_t array_length);
+
+/* Quicksort with three-way partitioning: items equal to the pivot are
+ * excluded from the recursion. Suited to inputs with few distinct values. */
+void Sort_quicksort_3way_array(char the_array[], size_t array_length);
+
+/* Quicksort using the given partition scheme, for comparing the schemes.
+ * SORT_PARTITION_BLOCK is the fastest on random data. */
+void Sort_quicksort_partition_array(char the_array[], size_t array_length, Sort_partition_scheme scheme);
+
+/* Non-recursive quicksort: pending ranges are kept on a fixed-size explicit
+ * stack, smaller side first, for O(log n) auxiliary space. */
+void Sort_quicksort_iterative_array(char the_array[], size_t array_length);
+
+/* Yaroslavskiy's dual-pivot quicksort: each partition splits the range
+ * in three around two pivots. */
+void Sort_quicksort_dual_pivot_array(char the_array[], size_t array_length);
+
+/* Counting sort: histogram of the 256 possible values, then one memset() per
+ * value. O(n), and the fastest of the routines here for char arrays. */
+void Sort_counting_array(char the_array[], size_t array_length);
+
+/* Counting sort parallelized over threads threads (0: one per online CPU):
+ * per-thread histograms, merged by prefix sum, then parallel fills. */
+void Sort_counting_parallel_array(char the_array[], size_t array_length, unsigned int threads);
+
+/* Quicksort parallelized over threads threads (0: one per online CPU), on a
+ * work-stealing thread pool. */
+void Sort_quicksort_parallel_array(char the_array[], size_t array_length, unsigned int threads);
+
 /* Sort the_array using a tree data structure */
 void Sort_treesort_array(char the_array[], unsigned int array_length);
 
@@ -65,3 +117,20 @@ void Sort_treesort_array(char the_array[], unsigned int array_length);
 void Sort_heapsort_array(char the_array[], int32_t size);
 
 
+/* ---------------------------- Generic versions ----------------------------
+   The routines below sort count elements of size bytes each, starting at base,
+   in ascending order as defined by compare (same contract as qsort(), see
+   sort_common.h). They implement the same algorithms as the char-based
+   array routines above, except for arrays of 1-byte elements, which all of
+   them counting sort, in linear time, whatever the comparator.
+*/
+void Sort_bubble_generic(void *base, size_t count, size_t size, Sort_compare_fn compare);
+
+void Sort_selection_generic(void *base, size_t count, size_t size, Sort_compare_fn compare);
+
+void Sort_insertion_generic(void *base, size_t count, size_t size, Sort_compare_fn compare);
+
+void Sort_quicksort_generic(void *base, size_t count, size_t size, Sort_compare_fn compare);
+
+void Sort_heapsort_generic(void *base, size_t count, size_t size, Sort_compare_fn compare);
+
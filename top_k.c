@@ -0,0 +1,290 @@
+#include "top_k.h"
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+/* ************************************************ */
+/* --------------- IMPLEMENTATION NOTES ------------*/
+/*                      * * *
+    The elements held are stored as an implicit min heap, laid out as the
+    max heap of heapsort.c, in an array of k elements allocated up front.
+
+    Until k elements are held, every element offered is added to the heap.
+    From then on, the root is the threshold: an element that doesn't compare
+    greater than it is rejected, and one that does replaces it, and is sifted
+    down from the root to its place, the heap staying at k elements.
+
+    Topk_push_all() appends the elements it needs to fill the heap up to k
+    in one go, and then builds the heap bottom-up, as Heap_max_heapify_bu()
+    does, in O(k) time rather than O(k log k) -- unless the heap already held
+    more elements than were just added, in which case they're sifted up one
+    by one instead. The rest of the batch goes straight through the
+    reject-or-replace test, which costs a single comparator call per element
+    rejected.
+
+    Topk_emit() copies the heap to the output array, and sorts it there the
+    way Heap_popS() does: the root is repeatedly swapped with the last element
+    of the heap, which then shrinks by one, and the new root sifted down. The
+    heap being a min heap, the array ends up sorted from the greatest down.
+
+    Ties are broken by arrival order: every element is numbered as it's
+    offered, and of two elements that compare equal, the later one orders
+    lower. So among equal elements, the first ones seen are kept, and
+    Topk_emit() outputs them in the order they came in. The numbers are kept
+    in an array alongside the heap, and moved with the elements.
+
+    As in priority_queue.c, the sifts keep the element being sifted aside, in
+    the scratch slot, and move the elements it passes over into its hole.
+*  -------------------------------------------------------------- */
+/* ************************************************************** */
+
+
+struct top_k{
+    char *elements;             // a min heap of count elements
+    uint64_t *arrivals;         // arrival number of each element held, for ties
+    uint64_t *emit_arrivals;    // where Topk_emit() sorts the arrival numbers
+    size_t count;
+    size_t k;
+    size_t element_size;
+    uint64_t offered;           // number of elements offered so far
+    uint64_t scratch_arrival;   // arrival number of the element in the scratch slot
+    Sort_compare_fn compare;
+    _Alignas(max_align_t) char scratch[];  // room for one element, being sifted; aligned like malloc() memory
+};
+
+
+
+
+
+
+
+/* ********************************************************************************* */
+/* ---------------------------- PRIVATE FUNCTIONS ---------------------------------- */
+
+static inline int Topk_order(Topk top, const char *a, uint64_t arrival_a, const char *b, uint64_t arrival_b){
+    /* compare(), with ties broken by arrival: of two equal elements, the one
+       offered later orders lower, so it's the one evicted first */
+    int order = top->compare(a, b);
+    if (order){
+        return order;
+    }
+    return (arrival_a < arrival_b) - (arrival_a > arrival_b);
+}
+
+
+
+static void Topk_sift_up(Topk top, size_t hole){
+    /* Sift the element in the scratch slot up the heap from the empty position hole */
+    size_t size = top->element_size;
+    char *base = top->elements;
+    uint64_t *arrivals = top->arrivals;
+
+    while (hole > 0){
+        size_t parent = (hole-1)>>1;
+        if (Topk_order(top, base + parent*size, arrivals[parent], top->scratch, top->scratch_arrival) <= 0){
+            break;
+        }
+        memcpy(base + hole*size, base + parent*size, size);
+        arrivals[hole] = arrivals[parent];
+        hole = parent;
+    }
+    memcpy(base + hole*size, top->scratch, size);
+    arrivals[hole] = top->scratch_arrival;
+}
+
+
+
+static void Topk_sift_down(Topk top, char *base, uint64_t arrivals[], size_t hole, size_t count){
+    /* Sift the element in the scratch slot down from the empty position hole
+       of the min heap of count elements starting at base, with arrival
+       numbers arrivals[] */
+    size_t size = top->element_size;
+    size_t child;
+
+    while ((child = 1 + (hole<<1)) < count){
+        // the smaller of the children
+        if (child+1 < count &&
+            Topk_order(top, base + (child+1)*size, arrivals[child+1], base + child*size, arrivals[child]) < 0){
+            child++;
+        }
+        if (Topk_order(top, base + child*size, arrivals[child], top->scratch, top->scratch_arrival) >= 0){
+            break;
+        }
+        memcpy(base + hole*size, base + child*size, size);
+        arrivals[hole] = arrivals[child];
+        hole = child;
+    }
+    memcpy(base + hole*size, top->scratch, size);
+    arrivals[hole] = top->scratch_arrival;
+}
+
+
+
+static inline void Topk_offer(Topk top, const char *element){
+    /* Reject-or-replace, for a full heap. The element being the latest
+       arrival, it loses ties with the threshold, so one comparator call is
+       still all a rejection takes. */
+    uint64_t arrival = top->offered++;
+
+    if (top->compare(element, top->elements) <= 0){
+        return;
+    }
+    memcpy(top->scratch, element, top->element_size);
+    top->scratch_arrival = arrival;
+    Topk_sift_down(top, top->elements, top->arrivals, 0, top->k);
+}
+
+/* ------------------------------- END PRIVATE ------------------------------------- */
+/* ********************************************************************************* */
+
+
+
+
+Topk Topk_create(size_t k, size_t element_size, Sort_compare_fn compare){
+    if (element_size == 0 || !compare){
+        return NULL;
+    }
+    if (k > SIZE_MAX / element_size || k > SIZE_MAX / sizeof(uint64_t)){
+        return NULL;
+    }
+
+    Topk top = malloc(sizeof(struct top_k) + element_size);
+    if (!top){
+        return NULL;
+    }
+    top->elements = malloc((k ? k : 1) * element_size);
+    top->arrivals = malloc((k ? k : 1) * sizeof(uint64_t));
+    top->emit_arrivals = malloc((k ? k : 1) * sizeof(uint64_t));
+    if (!top->elements || !top->arrivals || !top->emit_arrivals){
+        free(top->elements);
+        free(top->arrivals);
+        free(top->emit_arrivals);
+        free(top);
+        return NULL;
+    }
+    top->count = 0;
+    top->k = k;
+    top->element_size = element_size;
+    top->offered = 0;
+    top->compare = compare;
+
+    return top;
+}
+
+
+
+void Topk_destroy(Topk *top_ref){
+    if (!(*top_ref)){
+        return;
+    }
+    free((*top_ref)->elements);
+    free((*top_ref)->arrivals);
+    free((*top_ref)->emit_arrivals);
+    free(*top_ref);
+    *top_ref = NULL;
+}
+
+
+
+size_t Topk_count(Topk top){
+    return top->count;
+}
+
+
+
+const void *Topk_threshold(Topk top){
+    return top->count ? top->elements : NULL;
+}
+
+
+
+void Topk_push(Topk top, const void *element){
+    if (top->count < top->k){
+        memcpy(top->scratch, element, top->element_size);
+        top->scratch_arrival = top->offered++;
+        top->count++;
+        Topk_sift_up(top, top->count-1);
+        return;
+    }
+    if (top->k){
+        Topk_offer(top, element);
+    }
+}
+
+
+
+void Topk_push_all(Topk top, const void *elements, size_t count){
+    const char *next = elements;
+    size_t size = top->element_size;
+
+    if (top->count < top->k && count){
+        size_t old_count = top->count;
+        size_t added = top->k - top->count;
+
+        if (added > count){
+            added = count;
+        }
+        memcpy(top->elements + old_count*size, next, added*size);
+        for (size_t i = old_count; i < old_count + added; i++){
+            top->arrivals[i] = top->offered++;
+        }
+        top->count += added;
+        next += added*size;
+        count -= added;
+
+        if (added <= old_count){
+            for (size_t i = old_count; i < top->count; i++){
+                memcpy(top->scratch, top->elements + i*size, size);
+                top->scratch_arrival = top->arrivals[i];
+                Topk_sift_up(top, i);
+            }
+        }
+        else{
+            // bottom-up rebuild, as in Heap_max_heapify_bu()
+            for (size_t non_leaf = top->count>>1; non_leaf-- > 0;){
+                memcpy(top->scratch, top->elements + non_leaf*size, size);
+                top->scratch_arrival = top->arrivals[non_leaf];
+                Topk_sift_down(top, top->elements, top->arrivals, non_leaf, top->count);
+            }
+        }
+    }
+
+    if (top->k == 0){
+        top->offered += count;
+        return;
+    }
+    for (; count > 0; count--, next += size){
+        Topk_offer(top, next);
+    }
+}
+
+
+
+void Topk_emit(Topk top, void *out){
+    char *sorted = out;
+    uint64_t *arrivals = top->emit_arrivals;
+    size_t size = top->element_size;
+
+    if (top->count == 0){
+        return;
+    }
+    memcpy(sorted, top->elements, top->count*size);
+    memcpy(arrivals, top->arrivals, top->count*sizeof(uint64_t));
+
+    // Heap_popS(), on a min heap
+    for (size_t last_index = top->count; last_index-- > 1;){
+        memcpy(top->scratch, sorted + last_index*size, size);
+        top->scratch_arrival = arrivals[last_index];
+        memcpy(sorted + last_index*size, sorted, size);
+        arrivals[last_index] = arrivals[0];
+        Topk_sift_down(top, sorted, arrivals, 0, last_index);
+    }
+}
+
+
+
+void Topk_clear(Topk top){
+    top->count = 0;
+    top->offered = 0;
+}
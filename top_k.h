@@ -0,0 +1,65 @@
+#ifndef TOP_K_H
+#define TOP_K_H
+
+/* *********************** Overview ******************* */
+
+/* Streaming top-k: keeps the k greatest elements seen out of a stream of any
+ * length, in O(k) memory, without the stream ever being stored.
+ *
+ * Elements are of any fixed size, and ordered by a qsort()-style comparator,
+ * as for Pqueue (priority_queue.h). For the k smallest elements, pass a
+ * comparator with its result negated.
+ *
+ * The k elements are kept in a min heap, so the smallest of them -- the
+ * threshold any new element has to beat to get in -- is always at hand. Once
+ * k elements are held, an element that doesn't compare greater than the
+ * threshold is rejected with a single comparison, which is what happens to
+ * nearly all of a long stream. Ties are broken by arrival order: among equal
+ * elements, the first ones seen are kept, and an element equal to the
+ * threshold doesn't get in.
+ *
+ * All the memory is allocated when the accumulator is created, so nothing but
+ * Topk_create() can fail.
+ */
+
+
+#include <stddef.h>
+#include "sort_common.h"
+
+
+typedef struct top_k *Topk;
+
+
+
+/* Create an accumulator for the k greatest elements, of element_size bytes
+ * each, ordered by compare. Returns NULL if the memory couldn't be allocated. */
+Topk Topk_create(size_t k, size_t element_size, Sort_compare_fn compare);
+
+/* Free the accumulator. *top_ref is set to NULL. */
+void Topk_destroy(Topk *top_ref);
+
+/* Number of elements held: the number pushed so far, up to k */
+size_t Topk_count(Topk top);
+
+/* The smallest of the elements held, or NULL if there are none. Once k
+ * elements are held, a new one has to compare greater than this to get in.
+ * The pointer is only valid until the next push. */
+const void *Topk_threshold(Topk top);
+
+/* Offer a copy of *element. O(1) if rejected, O(log k) otherwise. */
+void Topk_push(Topk top, const void *element);
+
+/* Offer copies of the count elements starting at elements, in order. */
+void Topk_push_all(Topk top, const void *elements, size_t count);
+
+/* Copy the elements held to out, which must have room for Topk_count() of
+ * them, sorted from the greatest down, equal elements in the order they were
+ * pushed. The accumulator is left as it is, and
+ * can keep taking elements. O(k log k) */
+void Topk_emit(Topk top, void *out);
+
+/* Drop all the elements held, to start over with a new stream */
+void Topk_clear(Topk top);
+
+
+#endif
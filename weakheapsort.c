@@ -0,0 +1,172 @@
+#include "weakheapsort.h"
+#include "heapsort.h"
+#include <stdlib.h>
+
+
+/* ************************************************ */
+/* --------------- IMPLEMENTATION NOTES ------------*/
+/*                      * * *
+    A weak heap is a binary tree, stored implicitly in an array, with
+    looser ordering than a heap's: every node is only required to be no
+    smaller than the nodes of its right subtree, and the root, which has
+    no left subtree, no smaller than all the others.
+
+    Each node x has a reverse bit, r(x), and its children are at 2x + r(x)
+    (left) and 2x + 1 - r(x) (right). Flipping r(x) swaps x's subtrees, which
+    is what makes the looser ordering cheap to maintain.
+
+    The distinguished ancestor of a node j is the parent of the first node
+    on the path from j up to the root that is a right child -- the nearest
+    ancestor j has to be no greater than. Joining a node i with a node j of
+    which it's the distinguished ancestor takes a single comparison: if
+    a[j] > a[i], the two are swapped, and r(j) flipped so that j's former
+    left subtree, which a[i] hasn't been compared with, becomes its right
+    subtree, and the old right subtree, whose nodes are all <= the old a[j],
+    becomes its left subtree.
+
+                * * *
+    a) Building the weak heap takes n-1 joins, one per node from the last
+    one back to 1, each with the node's distinguished ancestor: n-1
+    comparisons in all.
+
+    b) Sorting: as in heapsort, the root, which is the largest element, is
+    swapped with the last element of the heap, which then shrinks by one.
+    To restore the weak heap, the path of left children is followed down
+    from the root's only child (node 1) to a leaf, and the root joined with
+    every node on that path, from the bottom up. That's one comparison per
+    level, about log2(n) per element removed, and none wasted on comparing
+    siblings with each other as Heap_sift_down() does.
+
+    The reverse bits are stored packed, 8 to a byte, in a buffer allocated
+    by each sort.
+*  -------------------------------------------------------------- */
+/* ************************************************************** */
+
+
+
+
+
+
+/* ********************************************************************************* */
+/* ---------------------------- PRIVATE FUNCTIONS ---------------------------------- */
+
+static inline unsigned int Weak_reverse_bit(const unsigned char reverse[], size_t node){
+    return (reverse[node>>3] >> (node & 7)) & 1;
+}
+
+static inline void Weak_flip_reverse_bit(unsigned char reverse[], size_t node){
+    reverse[node>>3] ^= (unsigned char)(1u << (node & 7));
+}
+
+
+
+static inline size_t Weak_distinguished_ancestor(const unsigned char reverse[], size_t node){
+    /* Climb while node is a left child, then return its parent */
+    while ((node & 1) == Weak_reverse_bit(reverse, node>>1)){
+        node >>= 1;
+    }
+    return node>>1;
+}
+
+
+
+static inline void Weak_join(char the_array[], unsigned char reverse[], size_t ancestor, size_t node){
+    if (the_array[node] > the_array[ancestor]){
+        char temp = the_array[node];
+        the_array[node] = the_array[ancestor];
+        the_array[ancestor] = temp;
+        Weak_flip_reverse_bit(reverse, node);
+    }
+}
+
+
+
+static inline void Weak_join_generic(char *base, unsigned char reverse[], size_t ancestor, size_t node,
+                                     size_t size, Sort_compare_fn compare){
+    if (compare(base + node*size, base + ancestor*size) > 0){
+        Sort_swap_elements(base + node*size, base + ancestor*size, size);
+        Weak_flip_reverse_bit(reverse, node);
+    }
+}
+
+/* ------------------------------- END PRIVATE ------------------------------------- */
+/* ********************************************************************************* */
+
+
+
+
+void Weak_heap_sort(char the_array[], size_t size){
+    if (size < 2){
+        return;
+    }
+    unsigned char *reverse = calloc((size+7)>>3, 1);
+    if (!reverse){
+        Heap_sort_bottom_up(the_array, size);
+        return;
+    }
+
+    // a) build the weak heap
+    for (size_t node = size-1; node > 0; node--){
+        Weak_join(the_array, reverse, Weak_distinguished_ancestor(reverse, node), node);
+    }
+
+    // b) move the root to the end, and restore the weak heap, until 2 elements are left
+    for (size_t last = size-1; last >= 2; last--){
+        char temp = the_array[0];
+        the_array[0] = the_array[last];
+        the_array[last] = temp;
+
+        size_t node = 1;
+        size_t child;
+        while ((child = 2*node + Weak_reverse_bit(reverse, node)) < last){
+            node = child;
+        }
+        for (; node > 0; node >>= 1){
+            Weak_join(the_array, reverse, 0, node);
+        }
+    }
+
+    char temp = the_array[0];
+    the_array[0] = the_array[1];
+    the_array[1] = temp;
+
+    free(reverse);
+}
+
+
+
+void Weak_heap_sort_generic(void *base, size_t count, size_t size, Sort_compare_fn compare){
+    /* Type-generic version of Weak_heap_sort(): sort count elements of size
+       bytes each, ordered by compare. */
+    char *the_array = base;
+
+    if (count < 2){
+        return;
+    }
+    unsigned char *reverse = calloc((count+7)>>3, 1);
+    if (!reverse){
+        Heap_sort_bottom_up_generic(base, count, size, compare);
+        return;
+    }
+
+    for (size_t node = count-1; node > 0; node--){
+        Weak_join_generic(the_array, reverse, Weak_distinguished_ancestor(reverse, node), node, size, compare);
+    }
+
+    for (size_t last = count-1; last >= 2; last--){
+        Sort_swap_elements(the_array, the_array + last*size, size);
+
+        size_t node = 1;
+        size_t child;
+        while ((child = 2*node + Weak_reverse_bit(reverse, node)) < last){
+            node = child;
+        }
+        for (; node > 0; node >>= 1){
+            Weak_join_generic(the_array, reverse, 0, node, size, compare);
+        }
+    }
+
+    Sort_swap_elements(the_array, the_array + size, size);
+
+    free(reverse);
+}
@@ -0,0 +1,27 @@
+#ifndef WEAKHEAPSORT_H
+#define WEAKHEAPSORT_H
+
+#include <stddef.h>
+#include "sort_common.h"
+
+/* Weak-heap sort (Dutton, 1993).
+ *
+ * Sorts with at most n log2(n) + 0.1n comparisons, against about 2n log2(n)
+ * for Heap_sort(), which makes it the heapsort of choice when comparisons are
+ * expensive (string keys, multi-field records); on cheap keys, the extra
+ * bookkeeping makes it slower than Heap_sort(). Not stable. O(n log n) time
+ * in the worst case.
+ *
+ * Unlike Heap_sort(), it needs one bit of extra memory per element. If that
+ * can't be allocated, the array is sorted by the bottom-up heapsort of
+ * heapsort.h instead, which needs none and makes not many more comparisons.
+ */
+
+// size is the number of elements in the_array
+void Weak_heap_sort(char the_array[], size_t size);
+
+// sort count elements of size bytes each, starting at base, ordered by compare
+void Weak_heap_sort_generic(void *base, size_t count, size_t size, Sort_compare_fn compare);
+
+
+#endif
@@ -0,0 +1,424 @@
+#define _POSIX_C_SOURCE 200809L
+#include "work_pool.h"
+#include <stdlib.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+
+
+/* ************************************************ */
+/* --------------- IMPLEMENTATION NOTES ------------*/
+/*                      * * *
+    Each thread's queue is a growable ring buffer guarded by its own mutex.
+    The owner and the thieves only ever contend for the same lock when the
+    thieves have nothing else to do, and a task is expected to be at least a
+    few microseconds' worth of work, so the cost of a lock per push and pop
+    doesn't matter.
+
+    pending counts the tasks submitted but not completed yet. It's
+    incremented before a task is queued and decremented after it has run,
+    so it only drops to 0 once there's no more work, queued or running.
+
+    A thread that can't find a task to steal -- a worker, or the one in
+    Pool_wait() -- keeps looking for POOL_SPIN_ROUNDS rounds, yielding the
+    CPU in between, since one of the running tasks is likely to submit more
+    shortly. After that, it parks: it sleeps on idle_cond until a task is
+    submitted, or, for the thread in Pool_wait(), until pending drops to 0.
+    Stretches of sequential work, such as the first partition of a sort,
+    would otherwise keep every other core spinning for their whole length.
+
+    parked counts the threads that are parked or about to be. A thread
+    increments it before its last look for a task, and Pool_submit() reads it
+    after queuing the task, so at least one of the two sees the other: either
+    the thread finds the task, or the submitter wakes it up. The wakeup bumps
+    wakeups, under idle_lock, so that a thread that hasn't started sleeping yet
+    doesn't miss it.
+*  -------------------------------------------------------------- */
+/* ************************************************************** */
+
+
+// initial capacity of each thread's queue; a power of two
+#define POOL_QUEUE_CAPACITY 64
+
+// times a thread looks for a task to steal, yielding in between, before it parks
+#define POOL_SPIN_ROUNDS 64
+
+
+struct pool_task{
+    Pool_task_fn function;
+    void *context;
+    size_t first;
+    size_t second;
+};
+
+struct pool_queue{
+    pthread_mutex_t lock;
+    struct pool_task *tasks;    // ring buffer of capacity tasks
+    size_t capacity;            // always a power of two
+    size_t top;                 // index of the oldest task, taken by thieves
+    size_t count;
+};
+
+struct work_pool{
+    unsigned int threads;
+    struct pool_queue *queues;  // one per thread; queue 0 belongs to whoever calls Pool_wait()
+    pthread_t *workers;         // threads-1 of them
+    atomic_uint next_worker_index;
+    atomic_size_t pending;
+
+    atomic_uint parked;         // threads asleep on idle_cond, or about to be
+
+    pthread_mutex_t idle_lock;
+    pthread_cond_t idle_cond;
+    unsigned long wakeups;      // bumped on every wakeup of the parked threads
+    bool shutting_down;
+};
+
+
+// the pool the calling thread is working for, if any, and the index of its queue
+static _Thread_local WorkPool Current_pool = NULL;
+static _Thread_local unsigned int Current_index = 0;
+
+
+
+
+/* ********************************************************************************* */
+/* ---------------------------- PRIVATE FUNCTIONS ---------------------------------- */
+
+static bool Queue_init(struct pool_queue *queue){
+    queue->tasks = malloc(POOL_QUEUE_CAPACITY * sizeof(struct pool_task));
+    if (!queue->tasks){
+        return false;
+    }
+    if (pthread_mutex_init(&queue->lock, NULL) != 0){
+        free(queue->tasks);
+        return false;
+    }
+    queue->capacity = POOL_QUEUE_CAPACITY;
+    queue->top = 0;
+    queue->count = 0;
+    return true;
+}
+
+
+
+static bool Queue_push_bottom(struct pool_queue *queue, struct pool_task task){
+    /* Add task to the bottom of queue, doubling its capacity if it's full.
+       Returns false if it was full and couldn't be grown. */
+    pthread_mutex_lock(&queue->lock);
+
+    if (queue->count == queue->capacity){
+        struct pool_task *grown = malloc(2 * queue->capacity * sizeof(struct pool_task));
+        if (!grown){
+            pthread_mutex_unlock(&queue->lock);
+            return false;
+        }
+        for (size_t i = 0; i < queue->count; i++){
+            grown[i] = queue->tasks[(queue->top + i) & (queue->capacity-1)];
+        }
+        free(queue->tasks);
+        queue->tasks = grown;
+        queue->capacity *= 2;
+        queue->top = 0;
+    }
+
+    queue->tasks[(queue->top + queue->count) & (queue->capacity-1)] = task;
+    queue->count++;
+
+    pthread_mutex_unlock(&queue->lock);
+    return true;
+}
+
+
+
+static bool Queue_pop_bottom(struct pool_queue *queue, struct pool_task *task){
+    /* Take the most recently pushed task off queue; the owner's end */
+    bool found = false;
+
+    pthread_mutex_lock(&queue->lock);
+    if (queue->count){
+        queue->count--;
+        *task = queue->tasks[(queue->top + queue->count) & (queue->capacity-1)];
+        found = true;
+    }
+    pthread_mutex_unlock(&queue->lock);
+    return found;
+}
+
+
+
+static bool Queue_steal_top(struct pool_queue *queue, struct pool_task *task){
+    /* Take the oldest task off queue; the thieves' end */
+    bool found = false;
+
+    pthread_mutex_lock(&queue->lock);
+    if (queue->count){
+        *task = queue->tasks[queue->top];
+        queue->top = (queue->top + 1) & (queue->capacity-1);
+        queue->count--;
+        found = true;
+    }
+    pthread_mutex_unlock(&queue->lock);
+    return found;
+}
+
+
+
+static bool Find_task(WorkPool pool, unsigned int index, struct pool_task *task){
+    /* Look for a task on the thread's own queue first, then try to steal
+       one from the others', starting with the next one along. */
+    if (Queue_pop_bottom(&pool->queues[index], task)){
+        return true;
+    }
+    for (unsigned int i = 1; i < pool->threads; i++){
+        if (Queue_steal_top(&pool->queues[(index + i) % pool->threads], task)){
+            return true;
+        }
+    }
+    return false;
+}
+
+
+
+static void Wake_parked(WorkPool pool, bool everyone){
+    /* Wake one of the parked threads, or all of them, if there are any */
+    if (atomic_load(&pool->parked) == 0){
+        return;
+    }
+    pthread_mutex_lock(&pool->idle_lock);
+    pool->wakeups++;
+    if (everyone){
+        pthread_cond_broadcast(&pool->idle_cond);
+    }
+    else{
+        pthread_cond_signal(&pool->idle_cond);
+    }
+    pthread_mutex_unlock(&pool->idle_lock);
+}
+
+
+
+static void Run_task(WorkPool pool, struct pool_task task){
+    task.function(pool, task.context, task.first, task.second);
+    if (atomic_fetch_sub(&pool->pending, 1) == 1){
+        // the thread in Pool_wait() may be parked, waiting for this
+        Wake_parked(pool, true);
+    }
+}
+
+
+
+static bool Park(WorkPool pool, unsigned int index, struct pool_task *task, bool until_idle){
+    /* Sleep until woken by Pool_submit() or Pool_destroy() -- or, if
+       until_idle, by the last task completing. Returns true, without
+       sleeping, if a task turns up in a last look for one, in *task. */
+    pthread_mutex_lock(&pool->idle_lock);
+    unsigned long seen = pool->wakeups;
+    pthread_mutex_unlock(&pool->idle_lock);
+
+    atomic_fetch_add(&pool->parked, 1);
+    atomic_thread_fence(memory_order_seq_cst);
+
+    bool found = Find_task(pool, index, task);
+    if (!found){
+        pthread_mutex_lock(&pool->idle_lock);
+        while (pool->wakeups == seen && !pool->shutting_down &&
+               !(until_idle && atomic_load(&pool->pending) == 0)){
+            pthread_cond_wait(&pool->idle_cond, &pool->idle_lock);
+        }
+        pthread_mutex_unlock(&pool->idle_lock);
+    }
+    atomic_fetch_sub(&pool->parked, 1);
+    return found;
+}
+
+
+
+static void *Worker_main(void *argument){
+    WorkPool pool = argument;
+    struct pool_task task;
+    unsigned int idle_rounds = 0;
+
+    Current_pool = pool;
+    Current_index = atomic_fetch_add(&pool->next_worker_index, 1);
+
+    for (;;){
+        if (Find_task(pool, Current_index, &task)){
+            Run_task(pool, task);
+            idle_rounds = 0;
+            continue;
+        }
+        if (idle_rounds < POOL_SPIN_ROUNDS){
+            idle_rounds++;
+            sched_yield();
+            continue;
+        }
+
+        idle_rounds = 0;
+        if (Park(pool, Current_index, &task, false)){
+            Run_task(pool, task);
+            continue;
+        }
+        pthread_mutex_lock(&pool->idle_lock);
+        bool stop = pool->shutting_down;
+        pthread_mutex_unlock(&pool->idle_lock);
+        if (stop){
+            return NULL;
+        }
+    }
+}
+
+
+
+static void Pool_free(WorkPool pool, unsigned int queues_initialized){
+    for (unsigned int i = 0; i < queues_initialized; i++){
+        pthread_mutex_destroy(&pool->queues[i].lock);
+        free(pool->queues[i].tasks);
+    }
+    pthread_cond_destroy(&pool->idle_cond);
+    pthread_mutex_destroy(&pool->idle_lock);
+    free(pool->queues);
+    free(pool->workers);
+    free(pool);
+}
+
+/* ------------------------------- END PRIVATE ------------------------------------- */
+/* ********************************************************************************* */
+
+
+
+
+WorkPool Pool_create(unsigned int threads){
+    if (threads == 0){
+        long online = sysconf(_SC_NPROCESSORS_ONLN);
+        threads = (online > 0) ? (unsigned int)online : 1;
+    }
+
+    WorkPool pool = malloc(sizeof(struct work_pool));
+    if (!pool){
+        return NULL;
+    }
+    pool->threads = threads;
+    pool->queues = malloc(threads * sizeof(struct pool_queue));
+    pool->workers = malloc(threads * sizeof(pthread_t));
+    atomic_init(&pool->next_worker_index, 1);
+    atomic_init(&pool->pending, 0);
+    atomic_init(&pool->parked, 0);
+    pool->wakeups = 0;
+    pool->shutting_down = false;
+
+    if (!pool->queues || !pool->workers){
+        free(pool->queues);
+        free(pool->workers);
+        free(pool);
+        return NULL;
+    }
+    pthread_mutex_init(&pool->idle_lock, NULL);
+    pthread_cond_init(&pool->idle_cond, NULL);
+
+    for (unsigned int i = 0; i < threads; i++){
+        if (!Queue_init(&pool->queues[i])){
+            Pool_free(pool, i);
+            return NULL;
+        }
+    }
+
+    for (unsigned int i = 0; i+1 < threads; i++){
+        if (pthread_create(&pool->workers[i], NULL, Worker_main, pool) != 0){
+            // stop the ones already started
+            pthread_mutex_lock(&pool->idle_lock);
+            pool->shutting_down = true;
+            pthread_cond_broadcast(&pool->idle_cond);
+            pthread_mutex_unlock(&pool->idle_lock);
+            for (unsigned int j = 0; j < i; j++){
+                pthread_join(pool->workers[j], NULL);
+            }
+            Pool_free(pool, threads);
+            return NULL;
+        }
+    }
+
+    return pool;
+}
+
+
+
+unsigned int Pool_threads(WorkPool pool){
+    return pool->threads;
+}
+
+
+
+void Pool_submit(WorkPool pool, Pool_task_fn task, void *context, size_t first, size_t second){
+    struct pool_task new_task = {task, context, first, second};
+    unsigned int index = (Current_pool == pool) ? Current_index : 0;
+
+    atomic_fetch_add(&pool->pending, 1);
+
+    if (!Queue_push_bottom(&pool->queues[index], new_task)){
+        Run_task(pool, new_task);
+        return;
+    }
+
+    // pairs with the fence in Park(): either a parking thread finds the task, or it's woken
+    atomic_thread_fence(memory_order_seq_cst);
+    Wake_parked(pool, false);
+}
+
+
+
+void Pool_wait(WorkPool pool){
+    /* The calling thread works for the pool, on queue 0, while it waits */
+    WorkPool outer_pool = Current_pool;
+    unsigned int outer_index = Current_index;
+    struct pool_task task;
+
+    Current_pool = pool;
+    Current_index = 0;
+
+    unsigned int idle_rounds = 0;
+
+    while (atomic_load(&pool->pending) > 0){
+        if (Find_task(pool, 0, &task)){
+            Run_task(pool, task);
+            idle_rounds = 0;
+        }
+        else if (idle_rounds < POOL_SPIN_ROUNDS){
+            idle_rounds++;
+            sched_yield();
+        }
+        else{
+            idle_rounds = 0;
+            if (Park(pool, 0, &task, true)){
+                Run_task(pool, task);
+            }
+        }
+    }
+
+    Current_pool = outer_pool;
+    Current_index = outer_index;
+}
+
+
+
+void Pool_destroy(WorkPool *pool_ref){
+    WorkPool pool = *pool_ref;
+
+    if (!pool){
+        return;
+    }
+
+    pthread_mutex_lock(&pool->idle_lock);
+    pool->shutting_down = true;
+    pthread_cond_broadcast(&pool->idle_cond);
+    pthread_mutex_unlock(&pool->idle_lock);
+
+    for (unsigned int i = 0; i+1 < pool->threads; i++){
+        pthread_join(pool->workers[i], NULL);
+    }
+
+    Pool_free(pool, pool->threads);
+    *pool_ref = NULL;
+}
@@ -0,0 +1,53 @@
+#ifndef WORK_POOL_H
+#define WORK_POOL_H
+
+/* *********************** Overview ******************* */
+
+/* A work-stealing thread pool, for the parallel sorting routines.
+ *
+ * Every thread of the pool -- including the one waiting on it in
+ * Pool_wait() -- owns a double-ended queue of tasks. A task submitted from
+ * inside a running task goes on the bottom of the submitting thread's own
+ * queue, and the thread takes its next task from that same end (LIFO), which
+ * keeps it working on the data it just touched. A thread whose queue is empty
+ * steals from the top of another thread's queue (FIFO), where the oldest,
+ * and in divide-and-conquer algorithms the largest, tasks are.
+ *
+ * Tasks are plain function calls with a context pointer and two size_t
+ * arguments, typically the bounds of the range of data to work on. They can
+ * submit further tasks to the pool they run on.
+ */
+
+
+#include <stddef.h>
+
+
+typedef struct work_pool *WorkPool;
+
+typedef void (*Pool_task_fn)(WorkPool pool, void *context, size_t first, size_t second);
+
+
+
+/* Create a pool of threads threads in total, counting the thread that will call
+ * Pool_wait() on it: threads-1 worker threads are started. 0 means one thread
+ * per online CPU. Returns NULL if the pool couldn't be created. */
+WorkPool Pool_create(unsigned int threads);
+
+/* The total number of threads in pool, as in Pool_create() */
+unsigned int Pool_threads(WorkPool pool);
+
+/* Queue task(pool, context, first, second) to be run by the pool.
+ * If memory for the queue runs out, the task is run right away by the calling
+ * thread instead, so submitting never fails. */
+void Pool_submit(WorkPool pool, Pool_task_fn task, void *context, size_t first, size_t second);
+
+/* Run tasks on the calling thread until every task submitted to pool, and every
+ * task those submitted in turn, has completed. */
+void Pool_wait(WorkPool pool);
+
+/* Stop the worker threads and free the pool. The pool must be idle.
+ * *pool_ref is set to NULL. */
+void Pool_destroy(WorkPool *pool_ref);
+
+
+#endif